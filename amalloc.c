@@ -1,19 +1,44 @@
 /*
  * debugging malloc()/realloc()/calloc()/free() that attempts
  * to keep track of just what's been allocated today.
+ *
+ * Built with USE_AMALLOC, every block is kept on a list and fenced
+ * with magic numbers so adump() can report leaks and corruption.
+ * Built with USE_ALLOC_STATS, blocks only carry their size, which
+ * is enough to keep the allocation accounting (see acharge()) and
+ * cheap enough to leave in a production build.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include "config.h"
+#include "amalloc.h"
+
+/* we need the real ones in here
+ */
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
 
 extern void* memset(void*,int,size_t);
 
 #define MAGIC 0x1f2e3d4c
 
+#if USE_AMALLOC
 struct alist { int magic, size, index; int *end; struct alist *next, *last; };
 
 static struct alist list =  { 0, 0, 0, 0 };
+#define PAD	0
+#define TAIL	sizeof(int)
+#else
+/* just the size, padded out so the block is still aligned for anything
+ */
+struct alist { int magic, size; };
+union aheader { struct alist a; long double ld; void *p; long l; };
+#define PAD	(sizeof(union aheader) - sizeof(struct alist))
+#define TAIL	0
+#endif
 
 static int mallocs=0;
 static int reallocs=0;
@@ -21,6 +46,35 @@ static int frees=0;
 
 static int index = 0;
 
+static struct acounts *charging = 0;
+
+/* charge allocations to `to` (or nobody, if it's null), returning
+ * whatever was being charged before
+ */
+struct acounts *
+acharge(struct acounts *to)
+{
+    struct acounts *ret = charging;
+
+    charging = to;
+    return ret;
+}
+
+
+static void
+charge(int allocs, int reallocs, long size)
+{
+    if ( charging ) {
+	charging->allocs += allocs;
+	charging->reallocs += reallocs;
+	if ( size > 0 )
+	    charging->bytes += size;
+	if ( (charging->live += size) > charging->peak )
+	    charging->peak = charging->live;
+    }
+}
+
+
 static void
 die(char *msg, int index)
 {
@@ -33,15 +87,18 @@ void *
 acalloc(int count, int size)
 {
     struct alist *ret;
+    char *base;
 
     if ( size > 1 ) {
 	count *= size;
 	size = 1;
     }
 
-    if ( ret = calloc(count + sizeof(struct alist) + sizeof(int), size) ) {
+    if ( base = calloc(PAD + sizeof(struct alist) + count + TAIL, size) ) {
+	ret = (struct alist*)(base + PAD);
 	ret->magic = MAGIC;
 	ret->size = size * count;
+#if USE_AMALLOC
 	ret->index = index ++;
 	ret->end = (int*)(count + (char*) (ret + 1));
 	*(ret->end) = ~MAGIC;
@@ -55,7 +112,9 @@ acalloc(int count, int size)
 	    ret->last = ret->next = &list;
 	    list.next = list.last = ret;
 	}
+#endif
 	++mallocs;
+	charge(1, 0, ret->size);
 	return ret+1;
     }
     return 0;
@@ -67,10 +126,12 @@ amalloc(int size)
 {
     void *ret = acalloc(1, size);
 
+#if USE_AMALLOC
     if ( ret ) {
 	/* explicitally fill the mallocated memory with a nonzero character */
 	memset(ret, 0x8f, size);
     }
+#endif
     return ret;
 }
 
@@ -80,13 +141,20 @@ afree(void *ptr)
 {
     struct alist *p2 = ((struct alist*)ptr)-1;
 
+    if ( ptr == 0 )
+	return;
+
     if ( p2->magic == MAGIC ) {
+#if USE_AMALLOC
 	if ( ! (p2->end && *(p2->end) == ~MAGIC) )
 	    die("goddam: corrupted memory block %d in free()!\n", p2->index);
 	p2->last->next = p2->next;
 	p2->next->last = p2->last;
+#endif
+	p2->magic = 0;
 	++frees;
-	free(p2);
+	charge(0, 0, -(long)p2->size);
+	free(((char*)p2) - PAD);
     }
     else
 	free(ptr);
@@ -97,9 +165,19 @@ void *
 arealloc(void *ptr, int size)
 {
     struct alist *p2 = ((struct alist*)ptr)-1;
+    int oldsize;
+#if USE_AMALLOC
     struct alist save;
+#else
+    char *base;
+#endif
+
+    if ( ptr == 0 )
+	return amalloc(size);
 
     if ( p2->magic == MAGIC ) {
+	oldsize = p2->size;
+#if USE_AMALLOC
 	if ( ! (p2->end && *(p2->end) == ~MAGIC) )
 	    die("goddam: corrupted memory block %d in realloc()!\n", p2->index);
 	save.next = p2->next;
@@ -113,6 +191,7 @@ arealloc(void *ptr, int size)
 	    p2->next->last = p2;
 	    p2->last->next = p2;
 	    ++reallocs;
+	    charge(0, 1, (long)size - oldsize);
 	    return p2+1;
 	}
 	else {
@@ -120,6 +199,16 @@ arealloc(void *ptr, int size)
 	    save.last->next = save.next;
 	    return 0;
 	}
+#else
+	if ( base = realloc(((char*)p2) - PAD, PAD + sizeof(*p2) + size) ) {
+	    p2 = (struct alist*)(base + PAD);
+	    p2->size = size;
+	    ++reallocs;
+	    charge(0, 1, (long)size - oldsize);
+	    return p2+1;
+	}
+	return 0;
+#endif
     }
     return realloc(ptr, size);
 }
@@ -128,6 +217,7 @@ arealloc(void *ptr, int size)
 void
 adump()
 {
+#if USE_AMALLOC
     struct alist *p;
 
 
@@ -135,6 +225,7 @@ adump()
 	fprintf(stderr, "allocated: %d byte%s\n", p->size, (p->size==1) ? "" : "s");
 	fprintf(stderr, "           [%.*s]\n", p->size, (char*)(p+1));
     }
+#endif
 
     if ( getenv("AMALLOC_STATISTICS") ) {
 	fprintf(stderr, "%d malloc%s\n", mallocs, (mallocs==1)?"":"s");
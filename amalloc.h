@@ -7,13 +7,25 @@
 
 #include "config.h"
 
-#ifdef USE_AMALLOC
+/* allocation accounting;  while a set of counters is being charged,
+ * every allocation, reallocation, and free is added to it.
+ */
+struct acounts {
+    long allocs;	/* malloc()s and calloc()s */
+    long reallocs;	/* realloc()s */
+    long bytes;		/* bytes asked for */
+    long live;		/* bytes allocated (and not freed) while charging */
+    long peak;		/* most bytes live at once */
+};
+
+#if defined(USE_AMALLOC) || defined(USE_ALLOC_STATS)
 
 extern void *amalloc(int);
 extern void *acalloc(int,int);
 extern void *arealloc(void*,int);
 extern void afree(void*);
 extern void adump();
+extern struct acounts *acharge(struct acounts *);
 
 #define malloc	amalloc
 #define	calloc	acalloc
@@ -24,6 +36,16 @@ extern void adump();
 
 #define adump()	(void)1
 
+/* nothing's being counted, but the counters that are handed back
+ * still have to be used so the compiler doesn't complain about them
+ */
+static inline struct acounts *
+acharge(struct acounts *x)
+{
+    (void)x;
+    return 0;
+}
+
 #endif
 
 #endif/*AMALLOC_D*/
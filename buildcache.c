@@ -0,0 +1,407 @@
+/*
+ * buildcache -- remember a hash of everything (source, template,
+ *               included files, flags) that went into each generated
+ *               html file, so a site rebuild only needs to remake the
+ *               pages that have actually changed.
+ *
+ * The hashes for all the html files in a directory are kept in a
+ * manifest file in that directory.   Several builds can share a
+ * directory, so the manifest is locked while it's being rewritten
+ * and only the entries this build changed are written over the ones
+ * that are in it then.
+ *
+ * Copyright (C) 2026 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef OS_WIN32
+#include <process.h>
+#define getpid	_getpid
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "cstring.h"
+#include "amalloc.h"
+#include "buildcache.h"
+
+#define MANIFEST	".discount-manifest"
+#define MAGIC		"discount manifest 1"
+
+struct entry {
+    char *name;		/* html file name (without the directory) */
+    bc_hash hash;
+    int changed;	/* recorded by this build */
+} ;
+
+struct manifest {
+    struct manifest *next;
+    char *dir;			/* directory this manifest is for */
+    STRING(struct entry) entries;
+    int sorted;			/* how many entries are in sorted order */
+    int dirty;			/* needs to be written out */
+} ;
+
+static struct manifest *manifests = 0;
+
+
+/* fnv-1a
+ */
+bc_hash
+bc_string(bc_hash h, char *p, int size)
+{
+    while ( size-- > 0 ) {
+	h ^= (unsigned char)*p++;
+	h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+/* hash the contents of a file (a file that can't be read hashes
+ * differently from an empty one)
+ */
+bc_hash
+bc_file(bc_hash h, char *path)
+{
+    FILE *f;
+    char buf[8192];
+    int size;
+
+    if ( (f = fopen(path, "r")) == 0 )
+	return bc_string(h, "\0missing", 8);
+
+    while ( (size = fread(buf, 1, sizeof buf, f)) > 0 )
+	h = bc_string(h, buf, size);
+    fclose(f);
+
+    return bc_string(h, "", 1);
+}
+
+
+/* hash a set of markdown flags
+ */
+bc_hash
+bc_flags(bc_hash h, mkd_flag_t *flags)
+{
+    int i;
+    char c;
+
+    for ( i=0; i < MKD_NR_FLAGS; i++ ) {
+	c = flags && mkd_flag_isset(flags, i);
+	h = bc_string(h, &c, 1);
+    }
+    return h;
+}
+
+
+static int
+entrycmp(const void *a, const void *b)
+{
+    return strcmp( ((struct entry*)a)->name, ((struct entry*)b)->name );
+}
+
+
+/* sort by name, with the entries this build changed after the ones
+ * that were already there
+ */
+static int
+mergecmp(const void *a, const void *b)
+{
+    int rc = entrycmp(a, b);
+
+    return rc ? rc : ( ((struct entry*)a)->changed - ((struct entry*)b)->changed );
+}
+
+
+/* split a path into directory + filename
+ */
+static char *
+splitpath(char *path, char **dir)
+{
+    char *slash = strrchr(path, '/');
+
+    if ( slash ) {
+	if ( *dir = malloc(1 + (slash-path)) ) {
+	    memcpy(*dir, path, slash-path);
+	    (*dir)[slash-path] = 0;
+	}
+	return slash+1;
+    }
+    *dir = strdup(".");
+    return path;
+}
+
+
+static char *
+manifestname(char *dir)
+{
+    char *ret = malloc(strlen(dir) + strlen(MANIFEST) + 2);
+
+    if ( ret )
+	sprintf(ret, "%s/%s", dir, MANIFEST);
+    return ret;
+}
+
+
+/* read the entries in a manifest file
+ */
+static void
+readmanifest(struct manifest *p, char *file)
+{
+    FILE *f;
+    char line[1024];
+    struct entry *e;
+    int size;
+
+    if ( f = fopen(file, "r") ) {
+	if ( fgets(line, sizeof line, f) && strncmp(line, MAGIC "\n", sizeof MAGIC) == 0 ) {
+	    while ( fgets(line, sizeof line, f) ) {
+		size = strlen(line);
+		if ( size < 18 || line[16] != ' ' || line[size-1] != '\n' )
+		    break;
+		line[size-1] = 0;
+
+		e = &EXPAND(p->entries);
+		e->hash = strtoull(line, 0, 16);
+		e->changed = 0;
+		if ( (e->name = strdup(line+17)) == 0 ) {
+		    --S(p->entries);
+		    break;
+		}
+	    }
+	}
+	fclose(f);
+    }
+}
+
+
+/* find (or read in) the manifest for a directory
+ */
+static struct manifest *
+manifest(char *dir)
+{
+    struct manifest *p;
+    char *file;
+
+    for ( p = manifests; p; p = p->next )
+	if ( strcmp(p->dir, dir) == 0 )
+	    return p;
+
+    if ( (p = calloc(1, sizeof *p)) == 0 || (p->dir = strdup(dir)) == 0 )
+	return 0;
+    CREATE(p->entries);
+    p->next = manifests;
+    manifests = p;
+
+    if ( (file = manifestname(dir)) == 0 )
+	return p;
+
+    readmanifest(p, file);
+    free(file);
+
+    qsort(T(p->entries), S(p->entries), sizeof T(p->entries)[0], entrycmp);
+    p->sorted = S(p->entries);
+    return p;
+}
+
+
+static struct entry *
+lookup(struct manifest *m, char *name)
+{
+    struct entry key;
+    int i;
+
+    key.name = name;
+
+    if ( m->sorted ) {
+	struct entry *e = bsearch(&key, T(m->entries), m->sorted,
+				  sizeof key, entrycmp);
+	if ( e )
+	    return e;
+    }
+    for ( i=m->sorted; i < S(m->entries); i++ )
+	if ( strcmp(T(m->entries)[i].name, name) == 0 )
+	    return &T(m->entries)[i];
+    return 0;
+}
+
+
+/* is an html file up to date with the things that go into it?
+ */
+int
+bc_fresh(char *path, bc_hash hash)
+{
+    char *dir, *name = splitpath(path, &dir);
+    struct manifest *m;
+    struct entry *e;
+    FILE *f;
+    int ret = 0;
+
+    if ( dir && (m = manifest(dir)) && (e = lookup(m, name))
+	     && (e->hash == hash) && (f = fopen(path, "r")) ) {
+	fclose(f);
+	ret = 1;
+    }
+
+    if ( dir )
+	free(dir);
+    return ret;
+}
+
+
+/* remember what went into a newly written html file
+ */
+void
+bc_record(char *path, bc_hash hash)
+{
+    char *dir, *name = splitpath(path, &dir);
+    struct manifest *m;
+    struct entry *e;
+
+    if ( strchr(name, '\n') )
+	;	/* can't be written to the manifest */
+    else if ( dir && (m = manifest(dir)) ) {
+	if ( e = lookup(m, name) ) {
+	    if ( e->hash != hash ) {
+		e->hash = hash;
+		e->changed = 1;
+		m->dirty = 1;
+	    }
+	}
+	else if ( name = strdup(name) ) {
+	    e = &EXPAND(m->entries);
+	    e->name = name;
+	    e->hash = hash;
+	    e->changed = 1;
+	    m->dirty = 1;
+	}
+    }
+    if ( dir )
+	free(dir);
+}
+
+
+/* lock a manifest (with a lock file beside it, because the manifest
+ * itself is replaced when it's written) so two builds don't write it
+ * at the same time.   The lock goes away when the lock file is closed.
+ */
+static int
+lockmanifest(char *file)
+{
+    int fd = -1;
+#ifndef OS_WIN32
+    char *name;
+    struct flock lock;
+
+    if ( name = malloc(strlen(file) + 6) ) {
+	sprintf(name, "%s.lock", file);
+	if ( (fd = open(name, O_RDWR|O_CREAT, 0666)) >= 0 ) {
+	    memset(&lock, 0, sizeof lock);
+	    lock.l_type = F_WRLCK;
+	    lock.l_whence = SEEK_SET;
+	    while ( (fcntl(fd, F_SETLKW, &lock) == -1) && (errno == EINTR) )
+		;
+	}
+	free(name);
+    }
+#endif
+    return fd;
+}
+
+
+/* write the entries this build changed into a manifest file, on top
+ * of whatever's in it now (another build may have rewritten it since
+ * it was read.)   It's written to a temporary file and renamed into
+ * place so a build that's interrupted doesn't leave a broken one
+ * behind.
+ */
+static int
+writemanifest(struct manifest *p, char *file)
+{
+    struct manifest now;
+    struct entry *e;
+    char *tmp;
+    FILE *f;
+    int i, lock, rc = 0;
+
+    if ( (tmp = malloc(strlen(file) + 20)) == 0 )
+	return EOF;
+    sprintf(tmp, "%s.%ld", file, (long)getpid());
+
+    lock = lockmanifest(file);
+
+    CREATE(now.entries);
+    readmanifest(&now, file);
+    for ( i=0; i < S(p->entries); i++ )
+	if ( T(p->entries)[i].changed ) {
+	    e = &EXPAND(now.entries);
+	    *e = T(p->entries)[i];
+	    T(p->entries)[i].name = 0;
+	}
+    qsort(T(now.entries), S(now.entries), sizeof T(now.entries)[0], mergecmp);
+
+    if ( f = fopen(tmp, "w") ) {
+	fprintf(f, "%s\n", MAGIC);
+	for ( i=0; i < S(now.entries); i++ ) {
+	    e = &T(now.entries)[i];
+	    if ( (i+1 < S(now.entries)) && (entrycmp(e, e+1) == 0) )
+		continue;	/* superseded by the next one */
+	    fprintf(f, "%016llx %s\n", e->hash, e->name);
+	}
+	if ( (fclose(f) == EOF) || (rename(tmp, file) != 0) ) {
+	    remove(tmp);
+	    rc = EOF;
+	}
+    }
+    else
+	rc = EOF;
+
+#ifndef OS_WIN32
+    if ( lock >= 0 )
+	close(lock);
+#endif
+
+    for ( i=0; i < S(now.entries); i++ )
+	free(T(now.entries)[i].name);
+    DELETE(now.entries);
+    free(tmp);
+    return rc;
+}
+
+
+/* write out all the manifests that have changed, then throw them
+ * all away.
+ */
+int
+bc_save(void)
+{
+    struct manifest *p;
+    char *file;
+    int i, rc = 0;
+
+    while ( p = manifests ) {
+	manifests = p->next;
+
+	if ( p->dirty && (file = manifestname(p->dir)) ) {
+	    if ( writemanifest(p, file) == EOF )
+		rc = EOF;
+	    free(file);
+	}
+
+	for ( i=0; i < S(p->entries); i++ )
+	    if ( T(p->entries)[i].name )
+		free(T(p->entries)[i].name);
+	DELETE(p->entries);
+	free(p->dir);
+	free(p);
+    }
+    return rc;
+}
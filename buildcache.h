@@ -0,0 +1,23 @@
+/*
+ * buildcache;  remember what went into each generated html file so
+ *              that unchanged pages don't need to be made again
+ */
+
+#ifndef __BUILDCACHE_D
+#define __BUILDCACHE_D
+
+#include <mkdio.h>
+
+typedef unsigned long long bc_hash;
+
+#define BC_START	14695981039346656037ULL
+
+extern bc_hash bc_string(bc_hash, char *, int);
+extern bc_hash bc_file(bc_hash, char *);
+extern bc_hash bc_flags(bc_hash, mkd_flag_t *);
+
+extern int  bc_fresh(char *, bc_hash);
+extern void bc_record(char *, bc_hash);
+extern int  bc_save(void);
+
+#endif/*__BUILDCACHE_D*/
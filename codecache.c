@@ -0,0 +1,386 @@
+/*
+ * codecache -- remember what the external code formatter did with
+ *              a block of code so that identical blocks (license
+ *              headers, install instructions, the same example in
+ *              every version of a manual) are only formatted once.
+ *
+ * Copyright (C) 2026 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+#define CODECACHE_MAGIC	"discount codecache 1"
+
+/* no single key or result is ever allowed to be bigger than this,
+ * so a bad size in a cache file can't overflow a Cstring
+ */
+#define CODECACHE_MAXENTRY	(1<<28)
+
+/* fnv-1a hash, which is cheap and good enough to spread
+ * code blocks around the buckets (the keys are compared in
+ * full before anything is believed.)
+ */
+static unsigned long
+hash(unsigned long h, char *p, int size)
+{
+    while ( size-- > 0 ) {
+	h ^= (unsigned char)*p++;
+	h *= 16777619UL;
+    }
+    return h;
+}
+
+
+static unsigned long
+keyhash(Codecache *cache, char *lang, char *code, int size)
+{
+    unsigned long h = 2166136261UL;
+
+    if ( cache->formatter )
+	h = hash(h, cache->formatter, 1+strlen(cache->formatter));
+    if ( lang )
+	h = hash(h, lang, strlen(lang));
+    h = hash(h, "", 1);
+
+    return hash(h, code, size);
+}
+
+
+/* build the lookup key for a block of code (lang, \0, code)
+ */
+static void
+makekey(Cstring *key, char *lang, char *code, int size)
+{
+    int szlang = lang ? strlen(lang) : 0;
+
+    CREATE(*key);
+    RESERVE(*key, szlang+size+1);
+    if ( szlang )
+	memcpy(T(*key), lang, szlang);
+    T(*key)[szlang] = 0;
+    memcpy(T(*key)+szlang+1, code, size);
+    S(*key) = szlang+size+1;
+}
+
+
+static int
+samekey(Codecache_entry *p, char *lang, char *code, int size)
+{
+    int szlang = lang ? strlen(lang) : 0;
+
+    if ( S(p->key) != szlang+size+1 )
+	return 0;
+    if ( szlang && memcmp(T(p->key), lang, szlang) )
+	return 0;
+    if ( T(p->key)[szlang] != 0 )
+	return 0;
+    return memcmp(T(p->key)+szlang+1, code, size) == 0;
+}
+
+
+#define entrysize(p)	(sizeof *(p) + S((p)->key) + S((p)->fmt))
+
+
+/* unlink an entry from the lru list
+ */
+static void
+unlink_lru(Codecache *cache, Codecache_entry *p)
+{
+    if ( p->newer )
+	p->newer->older = p->older;
+    else
+	cache->newest = p->older;
+
+    if ( p->older )
+	p->older->newer = p->newer;
+    else
+	cache->oldest = p->newer;
+
+    p->newer = p->older = 0;
+}
+
+
+/* put an entry at the head of the lru list
+ */
+static void
+make_newest(Codecache *cache, Codecache_entry *p)
+{
+    p->older = cache->newest;
+    p->newer = 0;
+    if ( cache->newest )
+	cache->newest->newer = p;
+    cache->newest = p;
+    if ( !cache->oldest )
+	cache->oldest = p;
+}
+
+
+/* take an entry out of the cache and delete it
+ */
+static void
+discard(Codecache *cache, Codecache_entry *p)
+{
+    Codecache_entry **q;
+
+    for ( q = &cache->bucket[p->hash % CODECACHE_BUCKETS]; *q; q = &(*q)->chain )
+	if ( *q == p ) {
+	    *q = p->chain;
+	    break;
+	}
+
+    unlink_lru(cache, p);
+    cache->bytes -= entrysize(p);
+    DELETE(p->key);
+    DELETE(p->fmt);
+    free(p);
+}
+
+
+/* create an empty cache that will hold (approximately) up to
+ * maxbytes of code + formatted output.
+ */
+Codecache *
+mkd_codecache(long maxbytes, char *formatter)
+{
+    Codecache *ret = calloc(1, sizeof *ret);
+
+    if ( ret ) {
+	ret->maxbytes = maxbytes;
+	if ( formatter && !(ret->formatter = strdup(formatter)) ) {
+	    free(ret);
+	    return 0;
+	}
+    }
+    return ret;
+}
+
+
+/* delete a cache and everything in it
+ */
+void
+mkd_free_codecache(Codecache *cache)
+{
+    if ( cache ) {
+	while ( cache->newest )
+	    discard(cache, cache->newest);
+	if ( cache->formatter )
+	    free(cache->formatter);
+	free(cache);
+    }
+}
+
+
+/* report how well the cache is doing
+ */
+void
+mkd_codecache_stats(Codecache *cache, long *hits, long *misses)
+{
+    if ( hits )
+	*hits = cache ? cache->hits : 0;
+    if ( misses )
+	*misses = cache ? cache->misses : 0;
+}
+
+
+/* attach a cache to a document;  the cache is shared, not owned, so
+ * it can (and should) be used for many documents.
+ */
+void
+mkd_e_code_cache(Document *f, Codecache *cache)
+{
+    if ( f )
+	f->cb.codecache = cache;
+}
+
+
+/* look up a block of code, returning the formatted text (which
+ * belongs to the cache) or 0 if it's not there.
+ */
+char *
+___mkd_codecache_get(Codecache *cache, char *lang, char *code, int size)
+{
+    unsigned long h;
+    Codecache_entry *p;
+
+    if ( !cache )
+	return 0;
+
+    h = keyhash(cache, lang, code, size);
+
+    for ( p = cache->bucket[h % CODECACHE_BUCKETS]; p; p = p->chain )
+	if ( (p->hash == h) && samekey(p, lang, code, size) ) {
+	    unlink_lru(cache, p);
+	    make_newest(cache, p);
+	    ++cache->hits;
+	    return T(p->fmt);
+	}
+
+    ++cache->misses;
+    return 0;
+}
+
+
+/* add a formatted block of code to the cache, throwing out the least
+ * recently used entries if the cache gets too big.
+ */
+void
+___mkd_codecache_put(Codecache *cache, char *lang, char *code, int size,
+					char *fmt, int szfmt)
+{
+    unsigned long h;
+    Codecache_entry *p;
+
+    if ( !cache )
+	return;
+
+    h = keyhash(cache, lang, code, size);
+
+    for ( p = cache->bucket[h % CODECACHE_BUCKETS]; p; p = p->chain )
+	if ( (p->hash == h) && samekey(p, lang, code, size) ) {
+	    discard(cache, p);
+	    break;
+	}
+
+    if ( (p = calloc(1, sizeof *p)) == 0 )
+	return;
+
+    p->hash = h;
+    makekey(&p->key, lang, code, size);
+    CREATE(p->fmt);
+    SUFFIX(p->fmt, fmt, szfmt);
+    COMPLETE(p->fmt);
+
+    if ( entrysize(p) > cache->maxbytes ) {
+	/* too big to ever fit */
+	DELETE(p->key);
+	DELETE(p->fmt);
+	free(p);
+	return;
+    }
+
+    cache->bytes += entrysize(p);
+    while ( cache->oldest && (cache->bytes > cache->maxbytes) )
+	discard(cache, cache->oldest);
+
+    p->chain = cache->bucket[h % CODECACHE_BUCKETS];
+    cache->bucket[h % CODECACHE_BUCKETS] = p;
+    make_newest(cache, p);
+}
+
+
+/* write the cache to a file, oldest entry first (so that reading
+ * it back in restores the lru order.)   The file starts with a
+ * magic line and the formatter identity, then each entry is
+ * written as a line with the key and result sizes followed by
+ * the key and result themselves.
+ */
+int
+mkd_codecache_save(Codecache *cache, FILE *output)
+{
+    Codecache_entry *p;
+
+    if ( !(cache && output) )
+	return EOF;
+
+    DO_OR_DIE( fprintf(output, "%s\n%s\n", CODECACHE_MAGIC,
+				 cache->formatter ? cache->formatter : "") );
+
+    for ( p = cache->oldest; p; p = p->newer ) {
+	DO_OR_DIE( fprintf(output, "%d %d\n", S(p->key), S(p->fmt)) );
+	if ( fwrite(T(p->key), S(p->key), 1, output) != 1 )
+	    return EOF;
+	if ( S(p->fmt) && fwrite(T(p->fmt), S(p->fmt), 1, output) != 1 )
+	    return EOF;
+    }
+    return 0;
+}
+
+
+/* read a saved cache back in.   If the file was written for a
+ * different formatter it's ignored.
+ */
+int
+mkd_codecache_load(Codecache *cache, FILE *input)
+{
+    Cstring line, key, fmt;
+    int szkey, szfmt, c;
+    int status = 0;
+
+    if ( !(cache && input) )
+	return EOF;
+
+    CREATE(line);
+    CREATE(key);
+    CREATE(fmt);
+
+    /* magic, then formatter */
+    for ( c = 0; c < 2; c++ ) {
+	int ch;
+
+	S(line) = 0;
+	while ( ((ch = getc(input)) != EOF) && (ch != '\n') )
+	    EXPAND(line) = ch;
+	COMPLETE(line);
+
+	if ( ch == EOF
+	    || strcmp(T(line), c ? (cache->formatter ? cache->formatter : "")
+				 : CODECACHE_MAGIC) ) {
+	    status = EOF;
+	    goto done;
+	}
+    }
+
+    while ( fscanf(input, "%d %d", &szkey, &szfmt) == 2 ) {
+	/* an entry that's bigger than the whole cache could never have
+	 * been saved in it, so it's a corrupt (or hostile) cache file
+	 */
+	if ( getc(input) != '\n' || szkey < 1 || szfmt < 0
+				 || szkey > CODECACHE_MAXENTRY
+				 || szfmt > CODECACHE_MAXENTRY
+				 || (long)szkey + szfmt > cache->maxbytes ) {
+	    status = EOF;
+	    break;
+	}
+
+	S(key) = S(fmt) = 0;
+	RESERVE(key, szkey);
+	RESERVE(fmt, szfmt);
+	if ( !(T(key) && T(fmt)) ) {
+	    status = EOF;
+	    break;
+	}
+
+	if ( fread(T(key), szkey, 1, input) != 1 ) {
+	    status = EOF;
+	    break;
+	}
+	if ( szfmt && fread(T(fmt), szfmt, 1, input) != 1 ) {
+	    status = EOF;
+	    break;
+	}
+
+	/* the key is lang \0 code */
+	c = strnlen(T(key), szkey);
+	if ( c >= szkey ) {
+	    status = EOF;
+	    break;
+	}
+	___mkd_codecache_put(cache, c ? T(key) : 0, T(key)+c+1, szkey-(c+1),
+			    T(fmt), szfmt);
+    }
+
+done:
+    DELETE(line);
+    DELETE(key);
+    DELETE(fmt);
+    return status;
+}
@@ -8,6 +8,8 @@
 # load in the configuration file
 #
 ac_help='--enable-amalloc	Enable memory allocation debugging
+--enable-alloc-stats	Count allocations made for each document
+--enable-threads	Compile and generate documents on several threads
 --with-tabstops=N	Set tabstops to N characters (default is 4)
 --shared		Build shared libraries (default is static)
 --container		Build inside a container
@@ -196,6 +198,9 @@ EOF
     rm -rf ngc$$*
 
 
+# for mkd_stats()
+AC_CHECK_FUNCS 'clock_gettime(CLOCK_MONOTONIC,0)' time.h
+
 if AC_CHECK_FUNCS srandom; then
     AC_DEFINE 'INITRNG(x)' 'srandom((unsigned int)x)'
 elif AC_CHECK_FUNCS srand; then
@@ -208,14 +213,6 @@ AC_CHECK_FUNCS 'memset((char*)0,0,0)' 'string.h' || \
 	    AC_CHECK_FUNCS 'memset((char*)0,0,0)' || \
 		      AC_FAIL "$TARGET requires memset"
 
-if AC_CHECK_FUNCS random; then
-    AC_DEFINE 'COINTOSS()' '(random()&1)'
-elif AC_CHECK_FUNCS rand; then
-    AC_DEFINE 'COINTOSS()' '(rand()&1)'
-else
-    AC_DEFINE 'COINTOSS()' '1'
-fi
-
 if AC_CHECK_FUNCS strcasecmp; then
     :
 elif AC_CHECK_FUNCS stricmp; then
@@ -252,10 +249,24 @@ AC_SUB    'TABSTOP' $TABSTOP
 if [ "$WITH_AMALLOC" ]; then
     AC_DEFINE	'USE_AMALLOC'	1
     AC_SUB	'AMALLOC'	'amalloc.o'
+elif [ "$WITH_ALLOC_STATS" ]; then
+    AC_DEFINE	'USE_ALLOC_STATS'	1
+    AC_SUB	'AMALLOC'	'amalloc.o'
 else
     AC_SUB	'AMALLOC'	''
 fi
 
+if [ "$WITH_THREADS" ]; then
+    # amalloc keeps its books in unlocked global variables
+    if [ "$WITH_AMALLOC" -o "$WITH_ALLOC_STATS" ]; then
+	AC_FAIL "--enable-threads can't be used with allocation debugging"
+    elif AC_CHECK_HEADERS pthread.h && AC_LIBRARY pthread_create -lpthread; then
+	AC_DEFINE	'USE_THREADS'	1
+    else
+	AC_FAIL "--enable-threads needs pthreads"
+    fi
+fi
+
 if [ "$H1TITLE" ]; then
     AC_SUB 'H1TITLE' h1title.o
     AC_DEFINE USE_H1TITLE 1
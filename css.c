@@ -46,8 +46,10 @@ mkd_css(Document *d, char **res)
 {
     Cstring f;
     int size;
+    struct acounts *charged;
 
     if ( res && d && d->compiled ) {
+	charged = ACHARGE(d, A_GENERATE);
 	*res = 0;
 	CREATE(f);
 	RESERVE(f, 100);
@@ -61,6 +63,7 @@ mkd_css(Document *d, char **res)
 	    *res = strdup(T(f));
 	}
 	DELETE(f);
+	acharge(charged);
 	return size;
     }
     return EOF;
@@ -30,7 +30,9 @@
  *          processed into a STRING (f->Q) of text and
  *          emphasis blocks.   After ___mkd_emblock() finishes,
  *          it truncates f->Q and leaves the rendered paragraph
- *          if f->out.
+ *          if f->out.   (Text that comes before the first
+ *          emphasis block is written straight to f->out, so
+ *          most paragraphs never go through here at all.)
  */
 
 
@@ -171,8 +173,10 @@ ___mkd_emblock(MMIOT *f)
 {
     int i;
     block *p;
+    double start;
 
     if ( S(f->Q) > 0 ) {
+	start = STAT_START(f);
 	emblock(f, 0, S(f->Q)-1);
     
 	for (i=0; i < S(f->Q); i++) {
@@ -185,5 +189,6 @@ ___mkd_emblock(MMIOT *f)
 				  DELETE(p->b_text); }
 	}
 	S(f->Q) = 0;
+	STAT_TIME(f, emblock, start);
     }
 } /* ___mkd_emblock */
@@ -0,0 +1,137 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/*
+ * escaping:  code, urls, and xml are written a byte at a time when
+ * there's something to escape, but most of any of them doesn't need
+ * it, so the clean stretches in between are found here (16 or 32
+ * bytes at a time, if the compiler lets us) and written all at once.
+ */
+
+/* the handful of vector operations that are needed, in whatever
+ * width the compiler was told it could use
+ */
+#if defined(__AVX2__)
+#define VECTOR		__m256i
+#define WIDTH		32
+#define SPLAT(c)	_mm256_set1_epi8(c)
+#define LOAD(p)		_mm256_loadu_si256((__m256i*)(p))
+#define EQ(a,b)		_mm256_cmpeq_epi8(a,b)
+#define OR(a,b)		_mm256_or_si256(a,b)
+#define AND(a,b)	_mm256_and_si256(a,b)
+#define MAX(a,b)	_mm256_max_epu8(a,b)
+#define MIN(a,b)	_mm256_min_epu8(a,b)
+#define BITS(a)		(unsigned int)_mm256_movemask_epi8(a)
+#define ALL		0xffffffffU
+#elif defined(__SSE2__)
+#define VECTOR		__m128i
+#define WIDTH		16
+#define SPLAT(c)	_mm_set1_epi8(c)
+#define LOAD(p)		_mm_loadu_si128((__m128i*)(p))
+#define EQ(a,b)		_mm_cmpeq_epi8(a,b)
+#define OR(a,b)		_mm_or_si128(a,b)
+#define AND(a,b)	_mm_and_si128(a,b)
+#define MAX(a,b)	_mm_max_epu8(a,b)
+#define MIN(a,b)	_mm_min_epu8(a,b)
+#define BITS(a)		(unsigned int)_mm_movemask_epi8(a)
+#define ALL		0xffffU
+#endif
+
+
+#ifdef WIDTH
+/* the first byte that was flagged in a mask
+ */
+static int
+firstbit(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int i;
+
+    for ( i=0; !(mask & 1); i++ )
+	mask >>= 1;
+    return i;
+#endif
+}
+#endif
+
+
+/* how many bytes at the front of s don't need to be escaped
+ */
+int
+___mkd_clean(char *s, int size, struct escapes *e)
+{
+    unsigned char *p = (unsigned char *)s;
+    unsigned int stopped[8];
+    int i, c, nrstop;
+
+#define DIRTY(c)	( ((c) < e->lo) || ((c) > e->hi) \
+			  || (stopped[(c) >> 5] & (1U << ((c) & 31))) )
+
+    memset(stopped, 0, sizeof stopped);
+    for ( nrstop=0; e->stop[nrstop]; nrstop++ ) {
+	c = (unsigned char)e->stop[nrstop];
+	stopped[c >> 5] |= 1U << (c & 31);
+    }
+
+    /* most clean runs are short, and are cheaper to find a byte at a
+     * time than to set up the vectors for
+     */
+    for ( i=0; (i < size) && (i < 16); i++ )
+	if ( DIRTY(p[i]) )
+	    return i;
+
+#ifdef WIDTH
+    if ( size-i >= WIDTH ) {
+	unsigned char stop[6];
+	int j;
+	VECTOR lo, hi, s0, s1, s2, s3, s4, s5;
+	VECTOR x, bad, inside;
+	unsigned int mask;
+
+	/* pad out the stop list with copies of its first byte, so there
+	 * are always the same number of them to look for
+	 */
+	for ( j=0; j < sizeof stop; j++ )
+	    stop[j] = e->stop[(j < nrstop) ? j : 0];
+
+	lo = SPLAT(e->lo); hi = SPLAT(e->hi);
+	s0 = SPLAT(stop[0]); s1 = SPLAT(stop[1]); s2 = SPLAT(stop[2]);
+	s3 = SPLAT(stop[3]); s4 = SPLAT(stop[4]); s5 = SPLAT(stop[5]);
+
+	for ( ; i+WIDTH <= size; i += WIDTH ) {
+	    x = LOAD(p+i);
+	    bad = OR(OR(OR(EQ(x,s0), EQ(x,s1)), OR(EQ(x,s2), EQ(x,s3))),
+		     OR(EQ(x,s4), EQ(x,s5)));
+	    inside = AND(EQ(MAX(x,lo),x), EQ(MIN(x,hi),x));
+	    mask = BITS(bad) | (BITS(inside) ^ ALL);
+	    if ( mask )
+		return i + firstbit(mask);
+	}
+    }
+#endif
+
+    /* and whatever's left over */
+    for ( ; (i < size) && !DIRTY(p[i]); i++ )
+	;
+    return i;
+#undef DIRTY
+}
@@ -0,0 +1,18 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <mkdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+char *sample = "% title\n% author\n% date\n# header\n\nsome *text* with [a link][1] and a footnote[^note]\n\n* one\n* [x] two\n\n1. a\n2. b\n\n> %quote%\n> quoted ~~text~~\n\n```c\nint x;\n```\n\n    code\n\n| a | b |\n|---|:-:|\n| c | d |\n\n->center<-\n\n<div>x</div>\n\nterm\n:   def\n\n[1]: http://example.com \"title\"\n[^note]: the note\n";
+int main(int argc,char**argv){
+  mkd_flag_t *flags = mkd_flags(); MMIOT *doc,*copy; char *buf,*html,*saved; int size,i,v,crash=0,tot=0;
+  mkd_set_flag_num(flags, MKD_FENCEDCODE); mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE); mkd_set_flag_num(flags, MKD_TOC);
+  mkd_set_flag_num(flags, MKD_DLEXTRA);
+  doc=mkd_string(sample,strlen(sample),flags); mkd_compile(doc,flags); size=mkd_serialize(doc,&buf);
+  saved=malloc(size); memcpy(saved,buf,size);
+  int vals[]={0,1,2,3,0x7f,0x80,0xff,0x7e,0x10,0x40};
+  for(i=4;i<size;i++) for(v=0;v<10;v++){ char *m=malloc(size); memcpy(m,saved,size); if((unsigned char)m[i]==vals[v]) {free(m);continue;} m[i]=vals[v]; tot++;
+    pid_t p=fork(); if(!p){ close(2); MMIOT*c=mkd_deserialize(m,size); if(c){ mkd_document(c,&html); char *t; mkd_toc(c,&t); mkd_cleanup(c);} _exit(0);} int st; waitpid(p,&st,0);
+    if(!WIFEXITED(st)||WEXITSTATUS(st)){crash++; if(argc>1) printf("byte %d val %d\n",i,vals[v]);} free(m);}
+  printf("%d/%d crashed (size %d)\n",crash,tot,size); return 0;}
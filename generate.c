@@ -34,8 +34,30 @@ int __mkd_footsort(Footnote *, Footnote *);
 static void
 push(char *bfr, int size, MMIOT *f)
 {
-    while ( size-- > 0 )
-	EXPAND(f->in) = *bfr++;
+    if ( size <= 0 )
+	return;
+    RESERVE(f->in, size);
+    memcpy(T(f->in) + S(f->in), bfr, size);
+    S(f->in) += size;
+}
+
+
+/*
+ * point the generator input at text that's already in memory instead
+ * of copying it into the input buffer.  The input buffer is handed
+ * back to the caller, who puts it back after text() has finished
+ * with the view (text() leaves nothing in either of them.)
+ */
+static Cstring
+view(char *bfr, int size, MMIOT *f)
+{
+    Cstring in = f->in;
+
+    T(f->in) = bfr;
+    S(f->in) = (size > 0) ? size : 0;
+    ALLOCATED(f->in) = 0;	/* so nothing tries to grow or free() it */
+    f->isp = 0;
+    return in;
 }
 
 
@@ -126,23 +148,26 @@ shift(MMIOT *f, int i)
 }
 
 
+/* Qtail() -- where output goes.   Until there's some emphasis in the
+ * queue there's nothing for ___mkd_emblock() to match, so it's written
+ * straight to f->out;  after that it's added to the last block in the
+ * queue.
+ */
+static inline Cstring *
+Qtail(MMIOT *f)
+{
+    return S(f->Q) ? &T(f->Q)[S(f->Q)-1].b_text : &f->out;
+}
+
+
 /* Qchar()
  */
 static void
 Qchar(int c, MMIOT *f)
 {
-    block *cur;
-
-    if ( S(f->Q) > 0 )
-	cur = &T(f->Q)[S(f->Q)-1];
-    else {
-	cur = &EXPAND(f->Q);
-	memset(cur, 0, sizeof *cur);
-	cur->b_type = bTEXT;
-    }
-
-    EXPAND(cur->b_text) = c;
+    Cstring *cur = Qtail(f);
 
+    EXPAND(*cur) = c;
 }
 
 
@@ -161,8 +186,15 @@ Qstring(char *s, MMIOT *f)
 static void
 Qwrite(char *s, int size, MMIOT *f)
 {
-    while (size-- > 0)
-	Qchar(*s++, f);
+    Cstring *cur;
+
+    if ( size <= 0 )
+	return;
+
+    cur = Qtail(f);
+    RESERVE(*cur, size);
+    memcpy(T(*cur) + S(*cur), s, size);
+    S(*cur) += size;
 }
 
 
@@ -203,6 +235,7 @@ Qem(MMIOT *f, char c, int count)
     p->b_count = count;
 
     memset(&EXPAND(f->Q), 0, sizeof(block));
+    STAT_ADD(f, emphasis, 1);
 }
 
 
@@ -222,6 +255,9 @@ ___mkd_reparse(char *bfr, int size, mkd_flag_t* flags, MMIOT *f, char *esc)
     
     sub.cb = f->cb;
     sub.ref_prefix = f->ref_prefix;
+    sub.seed = f->seed;
+    sub.stats = f->stats;
+    STAT_ADD(f, reparses, 1);
 
     if ( esc ) {
 	sub.esc = &e;
@@ -231,9 +267,10 @@ ___mkd_reparse(char *bfr, int size, mkd_flag_t* flags, MMIOT *f, char *esc)
     else
 	sub.esc = f->esc;
 
-    push(bfr, size, &sub);
-    pushc(0, &sub);
-    S(sub.in)--;
+    /* sub has an empty input buffer, so it doesn't need to be
+     * put back when the view is done with
+     */
+    view(bfr, size, &sub);
 
     text(&sub);
     ___mkd_emblock(&sub);
@@ -272,7 +309,9 @@ escaped(MMIOT *f, char c)
 static void
 puturl(char *s, int size, MMIOT *f, int display)
 {
+    static struct escapes urlchars = { '!', '~', { '&', '<', '"', '\\' } };
     unsigned char c;
+    int clean;
 
     if ( size && s[0] == '<' && s[size-1] == '>' ) {
 	/* urls encased in <> need to have the <>'s removed */
@@ -280,7 +319,15 @@ puturl(char *s, int size, MMIOT *f, int display)
 	size -= 2;
     }
 
-    while ( size-- > 0 ) {
+    while ( size > 0 ) {
+	if ( (clean = ___mkd_clean(s, size, &urlchars)) > 0 ) {
+	    Qwrite(s, clean, f);
+	    s += clean;
+	    size -= clean;
+	    continue;
+	}
+
+	--size;
 	c = *s++;
 
 	if ( c == '\\' && size-- > 0 ) {
@@ -319,12 +366,86 @@ eatspace(MMIOT *f)
 }
 
 
+/* where every [, (, or { in the input buffer closes, found in one
+ * pass the first time it's asked for, so a paragraph full of brackets
+ * that don't close isn't scanned to the end once for each of them.
+ *
+ * An opener that's escaped (\[) isn't one, but parenthetical() can
+ * still be started after it, so it gets the first closer at the level
+ * it's on (which is where parenthetical() would stop) and doesn't
+ * change the nesting of anything else.
+ */
+static char opener[] = "[({";
+static char closer[] = "])}";
+
+static void
+matchbrackets(int kind, MMIOT *f)
+{
+    int in = opener[kind], out = closer[kind];
+    int i, c, sp, size = S(f->in);
+    char *text = T(f->in);
+    int *end, *stack;
+
+    S(f->match[kind]) = 0;
+    RESERVE(f->match[kind], size);
+    if ( (stack = malloc((size+1) * sizeof stack[0])) == 0 )
+	return;
+    end = T(f->match[kind]);
+
+    if ( kind == 1 )
+	f->lastparen = -1;
+
+    for ( sp=0, i=0; i < size; i++ ) {
+	end[i] = EOF;
+	c = text[i];
+
+	if ( (c == '\\') && (i < size-1) && (text[i+1] == out || text[i+1] == in) ) {
+	    end[++i] = EOF;
+	    if ( text[i] == in )
+		stack[sp++] = -(i+1);	/* escaped */
+	    else if ( kind == 1 )
+		f->lastparen = i;
+	}
+	else if ( c == in )
+	    stack[sp++] = i;
+	else if ( c == out ) {
+	    if ( kind == 1 )
+		f->lastparen = i;
+	    while ( (sp > 0) && (stack[sp-1] < 0) )
+		end[-(stack[--sp]+1)] = i;
+	    if ( sp > 0 )
+		end[stack[--sp]] = i;
+	}
+    }
+    free(stack);
+    S(f->match[kind]) = size;
+}
+
+
 /* (match (a (nested (parenthetical (string.)))))
  */
 static int
 parenthetical(int in, int out, MMIOT *f)
 {
     int size, indent, c;
+    int kind, here = mmiottell(f);
+    char *p = strchr(opener, in);
+
+    /* if we're right after an opener, the match is already known
+     */
+    if ( p && (kind = p - opener, closer[kind] == out)
+	    && (here > 0) && (here <= S(f->in)) && (T(f->in)[here-1] == in) ) {
+	if ( S(f->match[kind]) != S(f->in) )
+	    matchbrackets(kind, f);
+	if ( S(f->match[kind]) == S(f->in) ) {
+	    if ( (size = T(f->match[kind])[here-1]) == EOF ) {
+		f->isp = S(f->in);
+		return EOF;
+	    }
+	    f->isp = size+1;
+	    return size - here;
+	}
+    }
 
     for ( indent=1,size=0; indent; size++ ) {
 	if ( (c = pull(f)) == EOF )
@@ -520,6 +641,12 @@ linkyurl(MMIOT *f, int image, Footnote *p)
     int c;
     int mayneedtotrim=0;
 
+    /* every way a url can end needs a ) after it */
+    if ( S(f->match[1]) != S(f->in) )
+	matchbrackets(1, f);
+    if ( (S(f->match[1]) == S(f->in)) && (f->lastparen < mmiottell(f)) )
+	return 0;
+
     if ( (c = eatspace(f)) == EOF )
 	return 0;
 
@@ -589,11 +716,20 @@ static struct _protocol {
 static int
 isautoprefix(char *text, int size)
 {
-    int i;
+    int i, c;
     struct _protocol *p;
 
+    /* (only compare the ones that start with the right letter, so
+     * every word in an autolinked document doesn't cost a strncasecmp
+     * for every protocol)
+     */
+    if ( size < 1 )
+	return 0;
+    c = tolower((unsigned char)text[0]);
+
     for (i=0, p=protocol; i < NRPROTOCOLS; i++, p++)
-	if ( (size >= p->nlen) && strncasecmp(text, p->name, p->nlen) == 0 )
+	if ( (c == p->name[0]) && (size >= p->nlen)
+			       && strncasecmp(text, p->name, p->nlen) == 0 )
 	    return 1;
     return 0;
 }
@@ -868,6 +1004,7 @@ linkylinky(int image, MMIOT *f)
 		    S(key.tag) = S(name);
 		}
 
+		STAT_ADD(f, footnote_lookups, 1);
 		if ( ref = bsearch(&key, T(f->footnotes->note),
 					 S(f->footnotes->note),
 					 sizeof key, (stfu)__mkd_footsort) ) {
@@ -906,33 +1043,161 @@ cputc(int c, MMIOT *f)
 
 
 /*
- * convert an email address to a string of nonsense
+ * convert an email address to a string of nonsense.   Each byte is
+ * written as a hex or decimal entity, picked by a little random
+ * number generator that's seeded from the address (and the document's
+ * seed, if it has one), so the same address always comes out the same
+ * way and documents can be cached.
  */
+static unsigned int
+mangleseed(char *s, int len, MMIOT *f)
+{
+    unsigned int h = 2166136261u ^ (unsigned int)f->seed;
+
+    while ( len-- > 0 )
+	h = (h ^ *((unsigned char*)(s++))) * 16777619u;
+    return h ? h : 1;
+}
+
+
 static void
-mangle(char *s, int len, MMIOT *f)
+mangle(char *s, int len, unsigned int *rng, MMIOT *f)
 {
+    static char hex[] = "0123456789abcdef";
+    char ent[sizeof "&#x00;"];
+    unsigned int c, x;
+    int size;
+
+    ent[0] = '&';
+    ent[1] = '#';
     while ( len-- > 0 ) {
+	c = *((unsigned char*)(s++));
+
+	x = *rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*rng = x;
+
 #if DEBIAN_GLITCH
-	Qprintf(f, "&#%02d;", *((unsigned char*)(s++)) );
-#else
-	Qstring("&#", f);
-	Qprintf(f, COINTOSS() ? "x%02x;" : "%02d;", *((unsigned char*)(s++)) );
+	x = 0;
 #endif
+	size = 2;
+	if ( x & 0x100 ) {
+	    ent[size++] = 'x';
+	    ent[size++] = hex[c >> 4];
+	    ent[size++] = hex[c & 0xf];
+	}
+	else {
+	    if ( c >= 100 )
+		ent[size++] = '0' + c / 100;
+	    ent[size++] = '0' + (c / 10) % 10;
+	    ent[size++] = '0' + c % 10;
+	}
+	ent[size++] = ';';
+	Qwrite(ent, size, f);
     }
 }
 
 
-/* nrticks() -- count up a row of tick marks
+/* tickruns() -- find all the runs of a tick mark in the input buffer,
+ *               so the spans can look up the run that closes them
+ *               instead of scanning forward for it (which, with a lot
+ *               of runs that don't close, is quadratic.)
+ */
+static char tickchars[] = "`~$";
+
+static struct tickruns *
+tickruns(MMIOT *f, int tickchar)
+{
+    struct tickruns *r;
+    char *p = strchr(tickchars, tickchar);
+    int i, j, l, maxlen, size = S(f->in);
+
+    if ( !(tickchar && p) )
+	return 0;
+    r = &f->ticks[p - tickchars];
+
+    if ( r->size == size )
+	return r;
+
+    S(r->start) = S(r->len) = S(r->least) = S(r->bylen) = S(r->first) = 0;
+    for ( l=0, i=0; i < size; i++ )
+	if ( (T(f->in)[i] == tickchar) && ((i == 0) || (T(f->in)[i-1] != tickchar)) )
+	    l++;
+    RESERVE(r->start, l);
+    RESERVE(r->len, l);
+
+    for ( maxlen = 0, i=0; i < size; i = j ) {
+	if ( T(f->in)[i] != tickchar ) {
+	    j = i+1;
+	    continue;
+	}
+	for ( j = i+1; (j < size) && (T(f->in)[j] == tickchar); j++ )
+	    ;
+	T(r->start)[S(r->start)++] = i;
+	T(r->len)[S(r->len)++] = j-i;
+	if ( j-i > maxlen )
+	    maxlen = j-i;
+    }
+
+    /* the shortest run from each run to the end */
+    RESERVE(r->least, S(r->len)+1);
+    S(r->least) = S(r->len)+1;
+    T(r->least)[S(r->len)] = size+1;
+    for ( i = S(r->len)-1; i >= 0; --i )
+	T(r->least)[i] = (T(r->len)[i] < T(r->least)[i+1]) ? T(r->len)[i]
+							   : T(r->least)[i+1];
+
+    /* and the runs sorted by length (first[l] is where the runs of
+     * length l start in bylen, first[l+1] is where they end)
+     */
+    RESERVE(r->first, maxlen+2);
+    S(r->first) = maxlen+2;
+    memset(T(r->first), 0, S(r->first) * sizeof T(r->first)[0]);
+    for ( i=0; i < S(r->len); i++ )
+	T(r->first)[T(r->len)[i]+1]++;
+    for ( l=1; l < S(r->first); l++ )
+	T(r->first)[l] += T(r->first)[l-1];
+
+    RESERVE(r->bylen, S(r->len));
+    S(r->bylen) = S(r->len);
+    for ( i=0; i < S(r->len); i++ ) {
+	l = T(r->len)[i];
+	T(r->bylen)[T(r->first)[l]++] = i;
+    }
+    /* (which moved first[l] up to where the runs of length l end) */
+    for ( l = S(r->first)-1; l > 0; --l )
+	T(r->first)[l] = T(r->first)[l-1];
+    T(r->first)[0] = 0;
+
+    r->size = size;
+    r->next = 0;
+    return r;
+} /* tickruns */
+
+
+/* the first run of length len at or after run #from, or EOF
  */
 static int
-nrticks(int offset, int tickchar, MMIOT *f)
+nextrun(struct tickruns *r, int len, int from)
 {
-    int  tick = 0;
+    int lo, hi, mid;
 
-    while ( peek(f, offset+tick) == tickchar ) tick++;
+    if ( (len < 1) || (len+1 >= S(r->first)) )
+	return EOF;
 
-    return tick;
-} /* nrticks */
+    lo = T(r->first)[len];
+    hi = T(r->first)[len+1];
+    while ( lo < hi ) {
+	mid = (lo + hi) / 2;
+	if ( T(r->bylen)[mid] < from )
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return (lo < T(r->first)[len+1]) ? T(r->bylen)[lo] : EOF;
+}
 
 
 /* matchticks() -- match a certain # of ticks, and if that fails
@@ -940,31 +1205,33 @@ nrticks(int offset, int tickchar, MMIOT *f)
  *
  *                 if a subset was matched, return the # of ticks
  *		   that were matched.
+ *
+ *		   (from is the first run after the opening ticks and
+ *		   end is where they end.)
  */
 static int
-matchticks(MMIOT *f, int tickchar, int ticks, int *endticks)
+matchticks(struct tickruns *r, int from, int end, int ticks, int *endticks)
 {
-    int size, count, c;
-    int subsize=0, subtick=0;
+    int run, l;
 
     *endticks = ticks;
-    for (size = 0; (c=peek(f,size+ticks)) != EOF; size ++) {
-	if ( (c == tickchar) && ( count = nrticks(size+ticks,tickchar,f)) ) {
-	    if ( count == ticks )
-		return size;
-	    else if ( count ) {
-		if ( (count > subtick) && (count < ticks) ) {
-		    subsize = size;
-		    subtick = count;
-		}
-		size += count;
-	    }
+
+    /* if every run from here on is too long, nothing can match */
+    if ( T(r->least)[from] > ticks )
+	return 0;
+
+    /* (it's usually the very next one) */
+    if ( T(r->len)[from] == ticks )
+	return T(r->start)[from] - end;
+
+    if ( (run = nextrun(r, ticks, from)) != EOF )
+	return T(r->start)[run] - end;
+
+    for ( l = ticks-1; l > 0; --l )
+	if ( (run = nextrun(r, l, from)) != EOF ) {
+	    *endticks = l;
+	    return T(r->start)[run] - end;
 	}
-    }
-    if ( subsize ) {
-	*endticks = subtick;
-	return subsize;
-    }
     return 0;
 } /* matchticks */
 
@@ -976,10 +1243,15 @@ matchticks(MMIOT *f, int tickchar, int ticks, int *endticks)
 static void
 code(MMIOT *f, char *s, int length)
 {
-    int i,c;
+    static struct escapes codechars = { 0, 0xff, { '&', '<', '>', MKD_EOLN, '\\' } };
+    int i,c,clean;
 
     for ( i=0; i < length; i++ )
-	if ( (c = s[i]) == MKD_EOLN)  /* expand back to 2 spaces */
+	if ( (clean = ___mkd_clean(s+i, length-i, &codechars)) > 0 ) {
+	    Qwrite(s+i, clean, f);
+	    i += clean-1;
+	}
+	else if ( (c = s[i]) == MKD_EOLN)  /* expand back to 2 spaces */
 	    Qstring("  ", f);
 	else if ( c == '\\' && (i < length-1) && escaped(f, s[i+1]) )
 	    cputc(s[++i], f);
@@ -1044,7 +1316,8 @@ forbidden_tag(MMIOT *f)
     if ( c == 'A' && is_flag_set(&f->flags, MKD_NOLINKS) && !isthisalnum(f,2) )
 	return 1;
     if ( c == 'I' && is_flag_set(&f->flags, MKD_NOIMAGE)
-		  && strncasecmp(cursor(f)+1, "MG", 2) == 0
+		  && toupper(peek(f,2)) == 'M'
+		  && toupper(peek(f,3)) == 'G'
 		  && !isthisalnum(f,4) )
 	return 1;
     return 0;
@@ -1080,15 +1353,16 @@ maybe_address(char *p, int size)
 
 
 /* The size-length token at cursor(f) is either a mailto:, an
- * implicit mailto:, one of the approved url protocols, or just
- * plain old text.   If it's a mailto: or an approved protocol,
- * linkify it, otherwise say "no"
+ * implicit mailto: (if the caller says it looks like an address),
+ * one of the approved url protocols, or just plain old text.   If
+ * it's a mailto: or an approved protocol, linkify it, otherwise
+ * say "no"
  */
 static int
-process_possible_link(MMIOT *f, int size)
+process_possible_link(MMIOT *f, int size, int address)
 {
-    int address= 0;
     int mailto = 0;
+    unsigned int rng;
     char *text = cursor(f);
 
     if ( is_flag_set(&f->flags, MKD_NOLINKS) ) return 0;
@@ -1100,18 +1374,17 @@ process_possible_link(MMIOT *f, int size)
 	address = 1;
 	mailto = 7; 	/* 7 is the length of "mailto:"; we need this */
     }
-    else 
-	address = maybe_address(text, size);
 
     if ( address ) { 
+	rng = mangleseed(text, size, f);
 	Qstring("<a href=\"", f);
 	if ( !mailto ) {
 	    /* supply a mailto: protocol if one wasn't attached */
-	    mangle("mailto:", 7, f);
+	    mangle("mailto:", 7, &rng, f);
 	}
-	mangle(text, size, f);
+	mangle(text, size, &rng, f);
 	Qstring("\">", f);
-	mangle(text+mailto, size-mailto, f);
+	mangle(text+mailto, size-mailto, &rng, f);
 	Qstring("</a>", f);
 	return 1;
     }
@@ -1146,7 +1419,8 @@ is_a_strict_tag_prefix(int c)
 static int
 maybe_tag_or_link(MMIOT *f)
 {
-    int c, size=0;
+    int c, tick, size=0;
+    char *p, *end;
 
     if ( is_flag_set(&f->flags, MKD_TAGTEXT) )
 	return 0;
@@ -1157,21 +1431,26 @@ maybe_tag_or_link(MMIOT *f)
 	/* By decree of Markdown.pl *this is a tag* and we want to absorb everything up
 	 * to the next '>', unless interrupted by another '<' OR a '`', at which point
 	 * we kick it back to the caller as plain old text.
+	 *
+	 * (Stopping at the next '<' is what keeps a line full of `<x`
+	 * from being scanned over and over, so the scan has to stop
+	 * at the first of them;  looking for the '>' first would
+	 * run to the end of the paragraph every time.)
 	 */
-	size=1;
-	while ( (c=peek(f,size+1)) != '>' ) {
-	    if ( c == EOF || c == '<' )
-		return 0;
-	    if ( is_flag_set(&f->flags, MKD_STRICT) ) {
-		if ( c == '`' )
-		    return 0;
-	    }
-	    size++;
-    }
+	tick = is_flag_set(&f->flags, MKD_STRICT) ? '`' : '>';
+	end = T(f->in) + S(f->in);
+
+	for ( p = cursor(f)+1; p < end; p++ )
+	    if ( (*p == '>') || (*p == '<') || (*p == tick) )
+		break;
+
+	if ( (p >= end) || (*p != '>') )
+	    return 0;
+	size = p - cursor(f);
     }
 
     if ( size > 0 ) {
-	if ( process_possible_link(f, size) ) {
+	if ( process_possible_link(f, size, maybe_address(cursor(f), size)) ) {
 	    shift(f, size+1);
 	    return 1;
 	}
@@ -1202,27 +1481,68 @@ maybe_tag_or_link(MMIOT *f)
 /* autolinking means that all inline html is <a href'ified>.   A
  * autolink url is alphanumerics, slashes, periods, underscores,
  * the at sign, colon, and the % character.
+ *
+ * Every word in a token (a.b:c, say) is a place where a link could
+ * start, and all of them end where the token does, so the end of the
+ * token (and where an address in it would have its @) is only looked
+ * for once.
  */
+struct autotoken {
+    int start, end;	/* the token is T(f->in)[start..end) */
+    int from, at;	/* the first character after from that can't be */
+			/* in the name part of an address */
+    int domain;		/* and what's after it could be the domain */
+};
+
 static int
-maybe_autolink(MMIOT *f)
+maybe_autolink(MMIOT *f, struct autotoken *tok)
 {
     register int c;
-    int size;
+    int size, here = mmiottell(f);
+    char *q, *end;
 
-    /* greedily scan forward for the end of a legitimate link.
-     */
-    for ( size=0; (c=peek(f, size+1)) != EOF; size++ ) {
-	if ( c == '\\' ) {
-	     if ( peek(f, size+2) != EOF )
-		++size;
+    if ( (here < tok->start) || (here >= tok->end) ) {
+	/* greedily scan forward for the end of a legitimate link.
+	 */
+	for ( size=0; (c=peek(f, size+1)) != EOF; size++ ) {
+	    if ( c == '\\' ) {
+		 if ( peek(f, size+2) != EOF )
+		    ++size;
+	    }
+	    else if ( c & 0x80 )	/* HACK: ignore utf-8 extended characters */
+		continue;
+	    else if ( isspace(c) || strchr("'\"()[]{}<>`", c) || c == MKD_EOLN )
+		break;
+	}
+	tok->start = here;
+	tok->end = here + size;
+	tok->from = tok->at = -1;
+    }
+
+    if ( (size = tok->end - here) <= 1 )
+	return 0;
+
+    if ( (here < tok->from) || (here > tok->at) ) {
+	/* find the end of the name part of an address, the way
+	 * maybe_address() does, and see if there's a domain after it
+	 */
+	end = T(f->in) + tok->end;
+	for ( q = cursor(f); (q < end) && (isalnum(*q) || strchr("._-+*", *q)); ++q )
+	    ;
+	tok->from = here;
+	tok->at = q - T(f->in);
+	tok->domain = 0;
+
+	if ( (q < end) && (*q == '@') && (++q < end) && (*q != '.') ) {
+	    for ( ; (q < end) && (isalnum(*q) || strchr("._-+", *q)); ++q )
+		if ( (*q == '.') && (q < end-1) )
+		    tok->domain = 1;
+	    if ( q < end )
+		tok->domain = 0;
 	}
-	else if ( c & 0x80 )	/* HACK: ignore utf-8 extended characters */
-	    continue;
-	else if ( isspace(c) || strchr("'\"()[]{}<>`", c) || c == MKD_EOLN )
-	    break;
     }
 
-    if ( (size > 1) && process_possible_link(f, size) ) {
+    if ( process_possible_link(f, size, (tok->at > here) && tok->domain) ) {
 	shift(f, size);
 	return 1;
     }
@@ -1392,13 +1712,36 @@ mathhandler(MMIOT *f, int e1, int e2)
 static int
 tickhandler(MMIOT *f, int tickchar, int minticks, int allow_space, spanhandler spanner)
 {
-    int endticks, size;
-    int tick = nrticks(0, tickchar, f);
+    int endticks, size, tick;
+    int lo, hi, mid, at = mmiottell(f)-1;
+    struct tickruns *r = tickruns(f, tickchar);
+
+    if ( !r || (at < 0) )
+	return 0;
+
+    /* find the run the cursor is in (usually the one after the last
+     * one we looked at, or the one after that if it closed a span)
+     */
+    lo = r->next;
+    if ( (lo+1 < S(r->start)) && (T(r->start)[lo+1] <= at) )
+	++lo;
+    if ( (lo >= S(r->start)) || (T(r->start)[lo] > at) || (T(r->start)[lo] + T(r->len)[lo] <= at) )
+	for ( lo = 0, hi = S(r->start); hi - lo > 1; ) {
+	    mid = (lo + hi) / 2;
+	    if ( T(r->start)[mid] <= at )
+		lo = mid;
+	    else
+		hi = mid;
+	}
+    if ( (lo >= S(r->start)) || (T(r->start)[lo] > at) )
+	return 0;
+    tick = T(r->start)[lo] + T(r->len)[lo] - at;
+    r->next = lo+1;
 
     if ( !allow_space && isspace(peek(f,tick)) )
 	return 0;
 
-    if ( (tick >= minticks) && (size = matchticks(f,tickchar,tick,&endticks)) ) {
+    if ( (tick >= minticks) && (size = matchticks(r, lo+1, at+tick, tick, &endticks)) ) {
 	if ( endticks < tick ) {
 	    size += (tick - endticks);
 	    tick = endticks;
@@ -1423,13 +1766,17 @@ text(MMIOT *f)
     int c, j;
     int rep;
     int smartyflags = 0;
+    struct autotoken tok = { 0, 0, -1, -1, 0 };
 
+    STAT_PEAK(f, peak_in, S(f->in));
 
     while (1) {
+	/* links only start at the front of a word */
 	if ( is_flag_set(&f->flags, MKD_AUTOLINK) && !is_flag_set(&f->flags, MKD_STRICT)
 						  && isalpha(peek(f,1))
+						  && !isalnum(peek(f,0))
 						  && !tag_text(f) )
-	    maybe_autolink(f);
+	    maybe_autolink(f, &tok);
 
 	c = pull(f);
 
@@ -1638,6 +1985,8 @@ text(MMIOT *f)
     }
     /* truncate the input string after we've finished processing it */
     S(f->in) = f->isp = 0;
+    S(f->match[0]) = S(f->match[1]) = S(f->match[2]) = 0;
+    f->ticks[0].size = f->ticks[1].size = f->ticks[2].size = 0;
 } /* text */
 
 
@@ -1646,6 +1995,8 @@ text(MMIOT *f)
 static void
 printheader(Paragraph *pp, MMIOT *f)
 {
+    Cstring in;
+
     if ( is_flag_set(&f->flags, MKD_IDANCHOR) ) {
 	Qprintf(f, "<h%d", pp->hnumber);
 	if ( pp->label && is_flag_set(&f->flags, MKD_TOC) && !is_flag_set(&f->flags, MKD_STRICT) ) {
@@ -1662,8 +2013,9 @@ printheader(Paragraph *pp, MMIOT *f)
 	}
 	Qprintf(f, "<h%d>", pp->hnumber);
     }
-    push(T(pp->text->text), S(pp->text->text), f);
+    in = view(T(pp->text->text), S(pp->text->text), f);
     text(f);
+    f->in = in;
     Qprintf(f, "</h%d>", pp->hnumber);
 }
 
@@ -1677,24 +2029,28 @@ static char* alignments[] = { "", " style=\"text-align:center;\"",
 typedef STRING(int) Istring;
 
 static int
-splat(Line *p, char *block, Istring align, int force, MMIOT *f)
+splat(Line *p, int skip, char *block, Istring align, int force, MMIOT *f)
 {
     int first,
-	idx = p->dle,
+	idx = p->dle + skip,
+	size = S(p->text),
 	colno = 0;
 
-
-    ___mkd_tidy(&p->text);
-    if ( S(p->text) > 0 && (T(p->text)[S(p->text)-1] == '|') )
-	--S(p->text);
+    /* trim trailing whitespace and the trailing pipe (without touching
+     * the line, because the tree may be rendered more than once)
+     */
+    while ( size && isspace(T(p->text)[size-1]) )
+	--size;
+    if ( size > 0 && (T(p->text)[size-1] == '|') )
+	--size;
 
     Qstring("<tr>\n", f);
-    while ( idx < S(p->text) ) {
+    while ( idx < size ) {
 	first = idx;
 	if ( force && (colno >= S(align)-1) )
-	    idx = S(p->text);
+	    idx = size;
 	else
-	    while ( (idx < S(p->text)) && (T(p->text)[idx] != '|') ) {
+	    while ( (idx < size) && (T(p->text)[idx] != '|') ) {
 		if ( T(p->text)[idx] == '\\' )
 		    ++idx;
 		++idx;
@@ -1726,6 +2082,7 @@ printtable(Paragraph *pp, MMIOT *f)
     Line *hdr, *dash, *body;
     Istring align;
     int hcols,start;
+    int skip;
     char *p;
     enum e_alignments it;
 
@@ -1733,19 +2090,14 @@ printtable(Paragraph *pp, MMIOT *f)
     dash= hdr->next;
     body= dash->next;
 
-    if ( T(hdr->text)[hdr->dle] == '|' ) {
-	/* trim leading pipe off all lines
-	 */
-	Line *r;
-	for ( r = pp->text; r; r = r->next )
-	    r->dle ++;
-    }
+    /* skip the leading pipe on all lines */
+    skip = (T(hdr->text)[hdr->dle] == '|');
 
     /* figure out cell alignments */
 
     CREATE(align);
 
-    for (p=T(dash->text), start=dash->dle; start < S(dash->text); ) {
+    for (p=T(dash->text), start=dash->dle+skip; start < S(dash->text); ) {
 	char first, last;
 	int end;
 
@@ -1767,7 +2119,7 @@ printtable(Paragraph *pp, MMIOT *f)
 
     Qstring("<table>\n", f);
     Qstring("<thead>\n", f);
-    hcols = splat(hdr, "th", align, 0, f);
+    hcols = splat(hdr, skip, "th", align, 0, f);
     Qstring("</thead>\n", f);
 
     if ( hcols < S(align) )
@@ -1778,7 +2130,7 @@ printtable(Paragraph *pp, MMIOT *f)
 
     Qstring("<tbody>\n", f);
     for ( ; body; body = body->next)
-	splat(body, "td", align, 1, f);
+	splat(body, skip, "td", align, 1, f);
     Qstring("</tbody>\n", f);
     Qstring("</table>\n", f);
 
@@ -1813,16 +2165,30 @@ code_callback(Line *t, char *lang, int fenced, Line **ret, MMIOT *f)
 	}
 	text[copy_p] = 0;
 
+	if ( !(lang && lang[0]) )
+	    lang = 0;
 
-	fmt = (*(f->cb->e_codefmt.func))(text, copy_p, (lang && lang[0]) ? lang : 0);
-	free(text);
+	/* if this block of code has been seen before, use the
+	 * remembered output instead of calling the formatter
+	 */
+	if ( fmt = ___mkd_codecache_get(f->cb->codecache, lang, text, copy_p) ) {
+	    free(text);
+	    Qwrite(fmt, strlen(fmt), f);
+	    *ret = t;
+	    return 1;
+	}
+
+	fmt = (*(f->cb->e_codefmt.func))(text, copy_p, lang);
 
 	if ( fmt ) {
+	    ___mkd_codecache_put(f->cb->codecache, lang, text, copy_p, fmt, strlen(fmt));
+	    free(text);
 	    Qwrite(fmt, strlen(fmt), f);
 	    *ret = t;
 	    if ( f->cb->e_codefmt.free ) (*f->cb->e_codefmt.free)(fmt, strlen(fmt), f);
 	    return 1;
 	}
+	free(text);
     }
     /* either the external formatter failed or doesn't exist,
      * so fall back to the traditional codeblock format
@@ -1864,8 +2230,22 @@ printblock(Paragraph *pp, MMIOT *f)
     static char *End[]   = { "", "</p>","</div>" };
     Line *t = pp->text;
     int align = pp->align;
+    int size;
+    Cstring in;
 
     Qstring(Begin[align], f);
+
+    if ( !t->next ) {
+	/* a paragraph that's only one line long is read where it is */
+	for ( size = S(t->text); size && isspace(T(t->text)[size-1]); --size )
+	    ;
+	in = view(T(t->text), size, f);
+	text(f);
+	f->in = in;
+	Qstring(End[align], f);
+	return 1;
+    }
+
     do {
 	if ( S(t->text) ) {
 	    if ( t->next && S(t->text) > 2
@@ -1876,8 +2256,11 @@ printblock(Paragraph *pp, MMIOT *f)
 		pushc('\n', f);
 	    }
 	    else {
-		___mkd_tidy(&t->text);
-		push(T(t->text), S(t->text), f);
+		size = S(t->text);
+
+		while ( size && isspace(T(t->text)[size-1]) )
+		    --size;
+		push(T(t->text), size, f);
 		if ( t->next )
 		    pushc('\n', f);
 	    }
@@ -2047,6 +2430,11 @@ display(Paragraph *p, MMIOT *f)
 {
     if ( !p ) return 0;
 
+    /* each block starts afresh;  a superscript at the start of
+     * one doesn't depend on how the block before it ended
+     */
+    f->last = 0;
+
     switch ( p->typ ) {
     case STYLE:
     case WHITESPACE:
@@ -2107,58 +2495,410 @@ display(Paragraph *p, MMIOT *f)
 static void
 mkd_extra_footnotes(MMIOT *m)
 {
-    int j, i;
+    int j, i, seen;
     Footnote *t;
+    STRING(int) byref;	/* which note has each refnumber */
 
     if ( m->footnotes->reference == 0 )
 	return;
 
     Csprintf(&m->out, "\n<div class=\"footnotes\">\n<hr/>\n<ol>\n");
 
-    for ( i=1; i <= m->footnotes->reference; i++ ) {
-	for ( j=0; j < S(m->footnotes->note); j++ ) {
-	    t = &T(m->footnotes->note)[j];
-	    if ( (t->refnumber == i) && (t->fn_flags & REFERENCED) ) {
-		Csprintf(&m->out, "<li id=\"%s:%d\">\n",
-			    p_or_nothing(m), t->refnumber);
-		htmlify(t->text, 0, 0, m);
-		Csprintf(&m->out, "<a href=\"#%sref:%d\" rev=\"footnote\">&#8617;</a>",
-			    p_or_nothing(m), t->refnumber);
-		Csprintf(&m->out, "</li>\n");
+    CREATE(byref);
+    for ( seen=0, i=1; i <= m->footnotes->reference; i++ ) {
+	if ( i > seen ) {
+	    /* find the notes that have been referenced since the last
+	     * time we looked (footnotes can refer to other footnotes)
+	     */
+	    while ( S(byref) <= m->footnotes->reference )
+		EXPAND(byref) = -1;
+	    for ( j=0; j < S(m->footnotes->note); j++ ) {
+		t = &T(m->footnotes->note)[j];
+		if ( (t->fn_flags & REFERENCED) && (t->refnumber > seen)
+					&& (t->refnumber < S(byref)) )
+		    T(byref)[t->refnumber] = j;
 	    }
+	    seen = m->footnotes->reference;
 	}
+	if ( T(byref)[i] < 0 )
+	    continue;
+
+	t = &T(m->footnotes->note)[T(byref)[i]];
+	Csprintf(&m->out, "<li id=\"%s:%d\">\n",
+		    p_or_nothing(m), t->refnumber);
+	htmlify(t->text, 0, 0, m);
+	Csprintf(&m->out, "<a href=\"#%sref:%d\" rev=\"footnote\">&#8617;</a>",
+		    p_or_nothing(m), t->refnumber);
+	Csprintf(&m->out, "</li>\n");
     }
+    DELETE(byref);
     Csprintf(&m->out, "</ol>\n</div>\n");
 }
 
 
+/* walk through a document the way it's generated, a block at a time
+ * (the paragraphs inside SOURCE blocks and everything else at the
+ * top level), telling visit() about each block and whether there's
+ * a blank line after it, until visit() says to stop.   An empty SOURCE
+ * block is visited as a null block, so the blank line after it isn't
+ * lost.
+ */
+typedef int (*Blockvisit)(Paragraph *, int, void *);
+
+static int
+eachblock(Paragraph *p, Blockvisit visit, void *ctx)
+{
+    Paragraph *c;
+
+    for ( ; p ; p = p->next ) {
+	if ( (p->typ == SOURCE) && p->down ) {
+	    for ( c = p->down; c; c = c->next )
+		if ( (*visit)(c, c->next || p->next, ctx) )
+		    return 1;
+	}
+	else if ( (*visit)((p->typ == SOURCE) ? 0 : p, p->next != 0, ctx) )
+	    return 1;
+    }
+    return 0;
+}
+
+
+/* where the blocks go, and who (if anyone) wants to know where the
+ * html for each of them ends
+ */
+struct blockout {
+    MMIOT *f;
+    Blockmark mark;
+    void *ctx;
+} ;
+
+static int
+htmlify_block(Paragraph *p, int gap, void *ctx)
+{
+    struct blockout *out = ctx;
+
+    if ( p ) {
+	display(p, out->f);
+	___mkd_emblock(out->f);
+	if ( out->mark && (*out->mark)(p, S(out->f->out), out->ctx) )
+	    return 1;
+    }
+    if ( gap )
+	Qstring("\n\n", out->f);
+    return 0;
+}
+
+
+/* htmlify() a document one block at a time, telling mark() (if there
+ * is one) where the html for each block ends.   Each block's html
+ * starts with the blank lines that separate it from the one before.
+ * Returns nonzero if mark() stopped it.
+ */
+static int
+htmlify_blocks(Paragraph *p, MMIOT *f, Blockmark mark, void *ctx)
+{
+    struct blockout out = { f, mark, ctx };
+    int stopped;
+
+    ___mkd_emblock(f);
+    stopped = eachblock(p, htmlify_block, &out);
+    ___mkd_emblock(f);
+    return stopped;
+}
+
+
+/* htmlify() a piece of a streamed document (see stream.c) into the
+ * html for the whole thing, after the blank lines that separate it
+ * from the piece before if there are any
+ */
+int
+___mkd_htmlify_piece(Paragraph *p, MMIOT *f, int gap, Blockmark mark, void *ctx)
+{
+    if ( gap ) {
+	___mkd_emblock(f);
+	Qstring("\n\n", f);
+    }
+    return htmlify_blocks(p, f, mark, ctx);
+}
+
+
+/* htmlify() a document on several threads, each of them doing a run
+ * of the same blocks that htmlify_blocks() marks.   The blocks don't
+ * depend on each other unless markdown extra footnotes are numbered as
+ * they're referenced, and the statistics and the code formatter cache
+ * aren't locked, so if any of those are in use it's done the
+ * old-fashioned way.
+ */
+struct piece {
+    Paragraph *p;
+    int gap;			/* followed by a blank line */
+} ;
+
+struct pieces {
+    STRING(struct piece) piece;
+    STRING(Cstring) out;	/* the html for each run */
+    int per;			/* # of pieces in each run */
+    MMIOT *f;
+} ;
+
+
+static void
+htmlify_run(int i, void *ctx)
+{
+    struct pieces *w = ctx;
+    struct piece *pc;
+    struct blockout out = { 0, 0, 0 };
+    MMIOT sub;
+    int j, end;
+
+    ___mkd_initmmiot(&sub, w->f->footnotes, &w->f->flags);
+    sub.cb = w->f->cb;
+    sub.ref_prefix = w->f->ref_prefix;
+    sub.seed = w->f->seed;
+
+    end = (i+1) * w->per;
+    if ( end > S(w->piece) )
+	end = S(w->piece);
+
+    out.f = &sub;
+    for ( j = i * w->per; j < end; j++ ) {
+	pc = &T(w->piece)[j];
+	htmlify_block(pc->p, pc->gap, &out);
+    }
+    ___mkd_emblock(&sub);
+
+    /* keep the html and throw away the rest */
+    T(w->out)[i] = sub.out;
+    CREATE(sub.out);
+    ___mkd_freemmiot(&sub, w->f->footnotes);
+}
+
+
+/* add a block to the list of pieces to be handed out
+ */
+static int
+addpiece(Paragraph *p, int gap, void *ctx)
+{
+    struct pieces *w = ctx;
+    struct piece *pc = &EXPAND(w->piece);
+
+    pc->p = p;
+    pc->gap = gap;
+    return 0;
+}
+
+
+static int
+htmlify_parallel(Document *d)
+{
+    struct pieces w;
+    int i, runs;
+
+    if ( (d->threads < 2) || d->stats || d->cb.codecache )
+	return 0;
+    for ( i=0; i < S(d->ctx->footnotes->note); i++ )
+	if ( T(d->ctx->footnotes->note)[i].fn_flags & EXTRA_FOOTNOTE )
+	    return 0;
+
+    CREATE(w.piece);
+    eachblock(d->code, addpiece, &w);
+
+    /* a few runs for each thread, so one slow run doesn't
+     * hold everything up
+     */
+    runs = 8 * d->threads;
+    if ( runs > S(w.piece) )
+	runs = S(w.piece);
+    if ( runs < 2 ) {
+	DELETE(w.piece);
+	return 0;
+    }
+    w.per = (S(w.piece) + runs - 1) / runs;
+    runs = (S(w.piece) + w.per - 1) / w.per;
+    w.f = d->ctx;
+
+    CREATE(w.out);
+    RESERVE(w.out, runs);
+    memset(T(w.out), 0, runs * sizeof T(w.out)[0]);
+    S(w.out) = runs;
+
+    if ( !___mkd_parallel(d->threads, runs, htmlify_run, &w) ) {
+	DELETE(w.out);
+	DELETE(w.piece);
+	return 0;
+    }
+
+    for ( i=0; i < runs; i++ ) {
+	SUFFIX(d->ctx->out, T(T(w.out)[i]), S(T(w.out)[i]));
+	DELETE(T(w.out)[i]);
+    }
+    DELETE(w.out);
+    DELETE(w.piece);
+    return 1;
+}
+
+
+/* generate the html for a document
+ */
+static void
+generate(Document *p, Blockmark mark, void *ctx)
+{
+    int size, stopped = 0;
+    double start;
+    struct acounts *charged;
+
+    charged = ACHARGE(p, A_GENERATE);
+    p->ctx->ref_prefix = p->ref_prefix;
+    p->ctx->seed = p->seed;
+    start = STAT_START(p);
+    if ( p->stream )
+	stopped = ___mkd_stream_html(p, mark, ctx);
+    else if ( mark || !htmlify_parallel(p) )
+	stopped = htmlify_blocks(p->code, p->ctx, mark, ctx);
+    if ( !stopped && is_flag_set(&p->ctx->flags, MKD_EXTRA_FOOTNOTE)
+	     && !is_flag_set(&p->ctx->flags, MKD_STRICT) )
+	mkd_extra_footnotes(p->ctx);
+    STAT_TIME(p, htmlify, start);
+    p->html = 1;
+    size = S(p->ctx->out);
+    STAT_ADD(p, bytes_out, size);
+    STAT_PEAK(p, peak_out, ALLOCATED(p->ctx->out));
+
+    if ( (size == 0) || T(p->ctx->out)[size-1] ) {
+	/* Add a null byte at the end of the generated html,
+	 * but pretend it doesn't exist.
+	 */
+	COMPLETE(p->ctx->out);
+    }
+    acharge(charged);
+}
+
+
+/* throw away the html for a document (and whatever state and
+ * footnote numbers generating it left behind) so it can be
+ * generated again
+ */
+void
+___mkd_forget_html(Document *p)
+{
+    int i;
+
+    p->html = 0;
+    S(p->ctx->out) = 0;
+    p->ctx->last = 0;
+    p->ctx->isp = 0;
+    p->ctx->footnotes->reference = 0;
+    for ( i=0; i < S(p->ctx->footnotes->note); i++ ) {
+	T(p->ctx->footnotes->note)[i].fn_flags &= ~REFERENCED;
+	T(p->ctx->footnotes->note)[i].refnumber = 0;
+    }
+}
+
+
 /* return a pointer to the compiled markdown
  * document.
  */
 int
 mkd_document(Document *p, char **res)
 {
-    int size;
-
     if ( p && p->compiled ) {
-	if ( ! p->html ) {
-	    htmlify(p->code, 0, 0, p->ctx);
-	    if ( is_flag_set(&p->ctx->flags, MKD_EXTRA_FOOTNOTE)
-		     && !is_flag_set(&p->ctx->flags, MKD_STRICT) )
-		mkd_extra_footnotes(p->ctx);
-	    p->html = 1;
-	    size = S(p->ctx->out);
-
-	    if ( (size == 0) || T(p->ctx->out)[size-1] ) {
-		/* Add a null byte at the end of the generated html,
-		 * but pretend it doesn't exist.
-		 */
-		COMPLETE(p->ctx->out);
-	    }
-	}
+	if ( ! p->html )
+	    generate(p, 0, 0);
 
 	*res = T(p->ctx->out);
 	return S(p->ctx->out);
     }
     return EOF;
 }
+
+
+/* generate the html for a document (again, if we already have) and
+ * tell mark() where each block of it ends
+ */
+int
+___mkd_document_blocks(Document *p, Blockmark mark, void *ctx)
+{
+    if ( !(p && p->compiled) )
+	return EOF;
+
+    if ( p->html )
+	___mkd_forget_html(p);
+    generate(p, mark, ctx);
+    return S(p->ctx->out);
+}
+
+
+/* render a compiled document into a malloc()ed string without
+ * changing the document, so it can be rendered again (with different
+ * options) or rendered from several threads at once
+ */
+int
+mkd_render_html(Document *p, struct mkd_render_options *opt, char **res)
+{
+    MMIOT f;
+    Callback_data cb;
+    struct footnote_list notes;
+    Footnote *fn;
+    int i, size;
+
+    if ( !(p && res && p->compiled) )
+	return EOF;
+
+    /* referencing a footnote numbers it, so give the generator its
+     * own copy of the footnote table (the contents are shared)
+     */
+    notes.reference = 0;
+    CREATE(notes.note);
+    if ( S(p->ctx->footnotes->note) ) {
+	RESERVE(notes.note, S(p->ctx->footnotes->note));
+	memcpy(T(notes.note), T(p->ctx->footnotes->note),
+	       S(p->ctx->footnotes->note) * sizeof T(notes.note)[0]);
+	S(notes.note) = S(p->ctx->footnotes->note);
+	for ( i=0; i < S(notes.note); i++ ) {
+	    fn = &T(notes.note)[i];
+	    fn->fn_flags &= ~REFERENCED;
+	    fn->refnumber = 0;
+	}
+    }
+
+    ___mkd_initmmiot(&f, &notes, &p->ctx->flags);
+    f.seed = p->seed;
+    if ( opt ) {
+	if ( opt->flags )
+	    ___mkd_or_flags(&f.flags, opt->flags);
+	cb.e_url = opt->e_url;
+	cb.e_flags = opt->e_flags;
+	cb.e_anchor = opt->e_anchor;
+	cb.e_codefmt = opt->e_codefmt;
+	cb.codecache = opt->codecache;
+	f.ref_prefix = opt->ref_prefix;
+    }
+    else {
+	cb = p->cb;
+	f.ref_prefix = p->ref_prefix;
+    }
+    f.cb = &cb;
+
+    htmlify(p->code, 0, 0, &f);
+    if ( is_flag_set(&f.flags, MKD_EXTRA_FOOTNOTE)
+	     && !is_flag_set(&f.flags, MKD_STRICT) )
+	mkd_extra_footnotes(&f);
+
+    if ( is_flag_set(&f.flags, MKD_CDATA) )
+	size = mkd_xml(T(f.out), S(f.out), res);
+    else {
+	/* strdup() the result so it can be free()d with the system
+	 * free() even in an amalloc() build
+	 */
+	COMPLETE(f.out);
+	size = S(f.out);
+	*res = strdup(T(f.out));
+    }
+
+    ___mkd_freemmiot(&f, &notes);
+    DELETE(notes.note);
+
+    if ( !*res )
+	return EOF;
+    return size;
+}
@@ -15,6 +15,8 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
 #include "config.h"
@@ -102,6 +104,10 @@ anchor_format(char *input, void *ctx)
 
 char *external_formatter = 0;
 
+/* how much formatted code to remember between runs
+ */
+#define CODECACHE_SIZE	(16*1024*1024)
+
 
 #define RECEIVER 0
 #define SENDER 1
@@ -167,6 +173,585 @@ external_codefmt(char *src, int len, char *lang)
 }
 
 
+/* load a saved code formatter cache (or start a new one if there
+ * isn't one, or it was written for a different formatter)
+ */
+mkd_codecache_t *
+open_codecache(char *file)
+{
+    mkd_codecache_t *cache = mkd_codecache(CODECACHE_SIZE, external_formatter);
+    FILE *f;
+
+    if ( cache && (f = fopen(file, "r")) ) {
+	if ( mkd_codecache_load(cache, f) == EOF ) {
+	    mkd_free_codecache(cache);
+	    cache = mkd_codecache(CODECACHE_SIZE, external_formatter);
+	}
+	fclose(f);
+    }
+    return cache;
+}
+
+
+/* save the code formatter cache (to a temporary file that's renamed
+ * into place, so an interrupted run doesn't leave a broken cache
+ * behind)
+ */
+static void
+save_codecache(mkd_codecache_t *cache, char *file)
+{
+    char *tmp;
+    FILE *f;
+
+    if ( tmp = malloc(strlen(file) + 20) ) {
+	sprintf(tmp, "%s.%ld", file, (long)getpid());
+
+	if ( f = fopen(tmp, "w") ) {
+	    if ( (mkd_codecache_save(cache, f) == EOF) | (fclose(f) == EOF) ) {
+		perror(tmp);
+		unlink(tmp);
+	    }
+	    else if ( rename(tmp, file) != 0 ) {
+		perror(file);
+		unlink(tmp);
+	    }
+	}
+	else
+	    perror(tmp);
+	free(tmp);
+    }
+}
+
+
+/* say how well the code formatter cache did, then save it
+ */
+void
+close_codecache(mkd_codecache_t *cache, char *file)
+{
+    long hits, misses;
+
+    mkd_codecache_stats(cache, &hits, &misses);
+    fprintf(stderr, "codecache: %ld hit%s, %ld miss%s\n",
+		    hits, (hits == 1) ? "" : "s",
+		    misses, (misses == 1) ? "" : "es");
+
+    save_codecache(cache, file);
+    mkd_free_codecache(cache);
+}
+
+
+/* where a batch worker leaves its share of the code formatter cache
+ */
+static char *
+workercache(char *file, pid_t worker)
+{
+    char *ret;
+
+    if ( ret = malloc(strlen(file) + 20) )
+	sprintf(ret, "%s.w%ld", file, (long)worker);
+    return ret;
+}
+
+
+/* fold the caches the batch workers left behind into the saved one,
+ * so the work all of them did is kept instead of only the work of
+ * whichever one finished last
+ */
+static void
+merge_codecache(char *file, pid_t *workers, int count)
+{
+    mkd_codecache_t *cache;
+    char *share;
+    FILE *f;
+    int i;
+
+    if ( (cache = open_codecache(file)) == 0 )
+	return;
+
+    for ( i=0; i < count; i++ ) {
+	if ( (share = workercache(file, workers[i])) == 0 )
+	    continue;
+	if ( f = fopen(share, "r") ) {
+	    mkd_codecache_load(cache, f);
+	    fclose(f);
+	    unlink(share);
+	}
+	free(share);
+    }
+    save_codecache(cache, file);
+    mkd_free_codecache(cache);
+}
+
+
+/* how each document is to be rendered
+ */
+struct settings {
+    mkd_flag_t *flags;
+    int debug;
+    int toc;
+    int content;
+    int styles;
+    int use_e_codefmt;
+    int github_flavoured;
+    int squash;
+    int stats;
+    int threads;
+    int stream;
+    char *extra_footnote_prefix;
+    char *urlflags;
+    char *urlbase;
+    char *codecache_file;
+    mkd_codecache_t *codecache;
+} how;
+
+
+/* a sink for mkd_generate_to()
+ */
+static int
+tofile(const char *text, int size, void *output)
+{
+    int did = fwrite(text, 1, size, (FILE*)output);
+
+    return ( did == 0 && ferror((FILE*)output) ) ? EOF : did;
+}
+
+
+/* apply the command line settings to a document, then write it
+ * (or its parse tree) to output
+ */
+int
+render(MMIOT *doc, FILE *output, char *name, mkd_flag_t *flags, char *prefix)
+{
+    int rc;
+
+    if ( how.urlbase )
+	mkd_basename(doc, how.urlbase);
+
+    if ( how.urlflags )
+	mkd_e_flags(doc, e_flags, NULL, how.urlflags);
+
+    if ( how.squash )
+	mkd_e_anchor(doc, (mkd_callback_t) anchor_format, callback_free, 0);
+
+    if ( how.use_e_codefmt ) {
+	mkd_e_code_format(doc, (mkd_callback_t)external_codefmt, callback_free, 0);
+
+	if ( how.codecache_file && !how.codecache )
+	    how.codecache = open_codecache(how.codecache_file);
+	if ( how.codecache )
+	    mkd_e_code_cache(doc, how.codecache);
+    }
+
+    if ( prefix )
+	mkd_ref_prefix(doc, prefix);
+
+    if ( how.threads > 1 )
+	mkd_threads(doc, how.threads);
+
+    if ( how.debug )
+	return mkd_dump(doc, output, flags, name);
+
+    rc = 1;
+    if ( mkd_compile(doc, flags) ) {
+	rc = 0;
+	if ( how.styles )
+	    mkd_generatecss(doc, output);
+	if ( how.toc )
+	    mkd_generatetoc(doc, output);
+	if ( how.content ) {
+	    /* write it out a block at a time, unless it's being
+	     * generated on several threads at once
+	     */
+	    if ( how.threads > 1 )
+		mkd_generatehtml(doc, output);
+	    else
+		mkd_generate_to(doc, tofile, output);
+	}
+	if ( how.stats ) {
+	    mkd_generatestats(doc, stderr);
+	    mkd_generateallocstats(doc, stderr);
+	}
+    }
+    return rc;
+}
+
+
+/* make all the directories leading up to path
+ */
+static int
+makepath(char *path)
+{
+    char *p;
+    int rc = 0;
+
+    for ( p = strchr(path+1, '/'); p && (rc == 0); p = strchr(p+1, '/') ) {
+	*p = 0;
+	if ( (mkdir(path, 0777) != 0) && (errno != EEXIST) )
+	    rc = -1;
+	*p = '/';
+    }
+    return rc;
+}
+
+
+/* where the html for a source file goes;  foo.text -> foo.html, either
+ * beside the source or (if an output directory was given) in the same
+ * relative place under the output directory.   So the output can't
+ * escape from the output directory, /a/foo.text goes to a/foo.html
+ * under it and ../foo.text to __/foo.html.
+ */
+static char *
+outputname(char *src, char *outdir)
+{
+    char *base = basename(src);
+    char *dot = strrchr(base, '.');
+    int size = (dot && dot != base) ? (dot - src) : strlen(src);
+    char *ret, *p;
+
+    if ( outdir )
+	for ( ; *src == '/'; --size )
+	    ++src;
+
+    if ( ret = malloc(size + (outdir ? strlen(outdir) : 0) + 7) ) {
+	if ( outdir ) {
+	    sprintf(ret, "%s/%.*s.html", outdir, size, src);
+	    for ( p = ret + strlen(outdir); p; p = strchr(p+1, '/') )
+		if ( p[1] == '.' && p[2] == '.' && p[3] == '/' )
+		    p[1] = p[2] = '_';
+	}
+	else
+	    sprintf(ret, "%.*s.html", size, src);
+    }
+    return ret;
+}
+
+
+struct output {
+    char *name;
+    int index;
+};
+
+static int
+byoutput(struct output *a, struct output *b)
+{
+    int rc = strcmp(a->name, b->name);
+
+    return rc ? rc : (a->index - b->index);
+}
+
+
+/* work out where the html for each file in a batch goes.   If two
+ * files would be written to the same place, only the first one is;
+ * the others are complained about and left out (so they count as
+ * failures.)
+ */
+static char **
+outputnames(char **files, int count, char *outdir)
+{
+    char **dest;
+    struct output *order;
+    int i, n, first;
+
+    if ( (dest = calloc(count+1, sizeof dest[0])) == 0 )
+	return 0;
+    if ( (order = malloc((count+1) * sizeof order[0])) == 0 ) {
+	free(dest);
+	return 0;
+    }
+
+    for ( n=i=0; i < count; i++ )
+	if ( dest[i] = outputname(files[i], outdir) ) {
+	    order[n].name = dest[i];
+	    order[n].index = i;
+	    n++;
+	}
+	else
+	    complain("%s: %s", files[i], strerror(errno));
+
+    qsort(order, n, sizeof order[0], (int(*)(const void*,const void*))byoutput);
+
+    for ( first=0, i=1; i < n; i++ )
+	if ( strcmp(order[i].name, order[first].name) == 0 ) {
+	    complain("%s: %s is already the html for %s", files[order[i].index],
+			order[i].name, files[order[first].index]);
+	    free(dest[order[i].index]);
+	    dest[order[i].index] = 0;
+	}
+	else
+	    first = i;
+
+    free(order);
+    return dest;
+}
+
+
+/* convert one file in a batch to dest, complaining (but carrying on)
+ * if anything goes wrong
+ */
+static int
+convert(char *src, char *dest, char *outdir)
+{
+    FILE *input, *output;
+    MMIOT *doc;
+    int rc = 1;
+
+    if ( dest == 0 )		/* already complained about */
+	return 1;
+
+    if ( (input = fopen(src, "r")) == 0 ) {
+	complain("%s: %s", src, strerror(errno));
+	return 1;
+    }
+
+    doc = how.github_flavoured ? gfm_in(input, how.flags)
+			       : mkd_in(input, how.flags);
+    fclose(input);
+
+    if ( !doc ) {
+	complain("%s: cannot read", src);
+	return 1;
+    }
+
+    if ( outdir && (makepath(dest) != 0) )
+	complain("%s: %s", dest, strerror(errno));
+    else if ( (output = fopen(dest, "w")) == 0 )
+	complain("%s: %s", dest, strerror(errno));
+    else {
+	if ( rc = render(doc, output, basename(src), how.flags, how.extra_footnote_prefix) )
+	    complain("%s: cannot compile", src);
+	if ( (fclose(output) == EOF) && (rc == 0) ) {
+	    complain("%s: %s", dest, strerror(errno));
+	    rc = 1;
+	}
+    }
+    mkd_cleanup(doc);
+    return rc;
+}
+
+
+/* read the list of files to convert from stdin, one per line
+ */
+static char **
+readlist(int *count)
+{
+    char **list = 0;
+    int size = 0, alloc = 0;
+    char line[PATH_MAX+2];
+    int len;
+
+    while ( fgets(line, sizeof line, stdin) ) {
+	len = strlen(line);
+	if ( len && line[len-1] == '\n' )
+	    line[--len] = 0;
+	if ( len == 0 )
+	    continue;
+
+	if ( size >= alloc ) {
+	    alloc = alloc ? (2*alloc) : 100;
+	    if ( (list = realloc(list, alloc * sizeof list[0])) == 0 ) {
+		perror("--from-list");
+		exit(1);
+	    }
+	}
+	if ( (list[size++] = strdup(line)) == 0 ) {
+	    perror("--from-list");
+	    exit(1);
+	}
+    }
+    *count = size;
+    return list;
+}
+
+
+/* convert a whole list of files.   If there's more than one job the
+ * work is handed out to a pool of worker processes, one file at a
+ * time through a pipe (the library isn't threadsafe, and separate
+ * processes means a bad document can't take down the whole batch.)
+ * Each worker keeps its settings (and code formatter cache) for all
+ * the files it converts, and leaves its cache behind to be merged
+ * into the saved one when they're all done.
+ *
+ * Returns the number of files that failed.
+ */
+static int
+convertall(char **files, char **dest, int count, char *outdir, int jobs)
+{
+    int work[2];
+    int i, status, nrworkers, failed = 0;
+    pid_t child, *workers;
+    char *share;
+
+    /* if there are more workers than files, the extras go
+     * into converting each file on several threads
+     */
+    if ( jobs > count ) {
+	if ( count > 0 )
+	    how.threads = jobs / count;
+	jobs = count;
+    }
+
+    if ( jobs <= 1 ) {
+	for ( i=0; i < count; i++ )
+	    failed += convert(files[i], dest[i], outdir);
+	if ( how.codecache )
+	    close_codecache(how.codecache, how.codecache_file);
+	return failed;
+    }
+
+    if ( (workers = malloc(jobs * sizeof workers[0])) == 0 ) {
+	perror("batch");
+	return count;
+    }
+    if ( pipe(work) != 0 ) {
+	perror("pipe");
+	free(workers);
+	return count;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    for ( i=0; i < jobs; i++ ) {
+	if ( (child = fork()) == 0 ) {
+	    close(work[SENDER]);
+	    while ( read(work[RECEIVER], &status, sizeof status) == sizeof status )
+		failed += convert(files[status], dest[status], outdir);
+	    if ( how.codecache && (share = workercache(how.codecache_file, getpid())) )
+		close_codecache(how.codecache, share);
+	    exit( (failed > 100) ? 100 : failed );
+	}
+	else if ( child < 0 ) {
+	    perror("fork");
+	    if ( i == 0 ) {
+		close(work[SENDER]);
+		close(work[RECEIVER]);
+		free(workers);
+		return count;
+	    }
+	    break;
+	}
+	workers[i] = child;
+    }
+    jobs = nrworkers = i;
+
+    /* each index is written in one piece, so workers never see a
+     * partial one
+     */
+    close(work[RECEIVER]);
+    signal(SIGPIPE, SIG_IGN);
+    for ( i=0; i < count; i++ )
+	if ( write(work[SENDER], &i, sizeof i) != sizeof i ) {
+	    perror("write");
+	    failed += count-i;
+	    break;
+	}
+    close(work[SENDER]);
+
+    while ( jobs > 0 && (child = wait(&status)) > 0 ) {
+	--jobs;
+	if ( WIFEXITED(status) )
+	    failed += WEXITSTATUS(status);
+	else {
+	    complain("worker %ld died", (long)child);
+	    failed++;
+	}
+    }
+
+    if ( how.use_e_codefmt && how.codecache_file )
+	merge_codecache(how.codecache_file, workers, nrworkers);
+    free(workers);
+    return failed;
+}
+
+
+/* convert a whole list of files, either beside themselves or into an
+ * output directory
+ */
+static int
+batch(char **files, int count, char *outdir, int jobs)
+{
+    char **dest;
+    int i, failed;
+
+    if ( outdir && (mkdir(outdir, 0777) != 0) && (errno != EEXIST) ) {
+	perror(outdir);
+	return count;
+    }
+    if ( (dest = outputnames(files, count, outdir)) == 0 ) {
+	perror("batch");
+	return count;
+    }
+
+    failed = convertall(files, dest, count, outdir, jobs);
+
+    for ( i=0; i < count; i++ )
+	if ( dest[i] )
+	    free(dest[i]);
+    free(dest);
+    return failed;
+}
+
+
+/* add to the list of flags a client passes on to the daemon
+ */
+static int
+clientflag(char **list, char *more)
+{
+    char *grown;
+
+    if ( *list == 0 )
+	return (*list = strdup(more)) != 0;
+
+    if ( (grown = realloc(*list, strlen(*list)+strlen(more)+2)) == 0 )
+	return 0;
+    strcat(strcat(grown, ","), more);
+    *list = grown;
+    return 1;
+}
+
+
+/* render a document for the markdown daemon, using the command line
+ * settings plus any flags and footnote prefix the client asked for
+ */
+static int
+serve_request(char *text, int size, char *reqflags, char *prefix, FILE *output)
+{
+    mkd_flag_t *flags;
+    MMIOT *doc;
+    char *q;
+    int rc;
+
+    if ( (flags = mkd_copy_flags(how.flags)) == 0 ) {
+	fprintf(output, "out of memory");
+	return 1;
+    }
+    if ( reqflags && (q = mkd_set_flag_string(flags, reqflags)) ) {
+	fprintf(output, "unknown option <%s>", q);
+	mkd_free_flags(flags);
+	return 1;
+    }
+
+    doc = how.github_flavoured ? gfm_string(text, size, flags)
+			       : mkd_string(text, size, flags);
+    if ( !doc ) {
+	fprintf(output, "cannot read document");
+	mkd_free_flags(flags);
+	return 1;
+    }
+
+    rc = render(doc, output, "request", flags,
+		     prefix ? prefix : how.extra_footnote_prefix);
+    mkd_cleanup(doc);
+    mkd_free_flags(flags);
+    return rc;
+}
+
+extern int serve(char *, int, int (*)(char *, int, char *, char *, FILE *));
+extern int client(char *, char *, char *, FILE *, FILE *);
+
+
+enum { CODECACHE=1, FROMLIST, SERVE, CLIENT, STATS, STREAM };
+
 struct h_opt opts[] = {
     { 0, "html5",  '5', 0,           "recognise html5 block elements" },
     { 0, "base",   'b', "url-base",  "URL prefix" },
@@ -176,15 +761,22 @@ struct h_opt opts[] = {
     { 0, 0,        'F', "bitmap",    "set/show hex flags" },
     { 0, 0,        'f', "{+-}flags", "set/show named flags" },
     { 0, 0,        'G', 0,           "github flavoured markdown" },
+    { 0, 0,        'j', "jobs",      "convert files with `jobs` parallel workers" },
     { 0, 0,        'n', 0,           "don't write generated html" },
     { 0, 0,        's', "text",      "format `text`" },
     { 0, "style",  'S', 0,           "output <style> blocks" },
     { 0, 0,        't', "text",      "format `text` with mkd_line()" },
     { 0, "toc",    'T', 0,           "output a TOC" },
     { 0, 0,        'C', "prefix",    "prefix for markdown extra footnotes" },
-    { 0, 0,        'o', "file",      "write output to file" },
+    { 0, 0,        'o', "file",      "write output to file (or directory, for many files)" },
     { 0, "squash", 'x', 0,           "squash toc labels to be more like github" },
     { 0, "codefmt",'X', "command",   "use an external code formatter" },
+    { CODECACHE, "codecache", 0, "file", "remember external code formatter output in `file`" },
+    { FROMLIST, "from-list", 0, 0,   "read the names of files to convert from stdin" },
+    { SERVE, "serve", 0, "socket",   "render documents sent to `socket` (with -j workers)" },
+    { CLIENT, "client", 0, "socket", "have the daemon at `socket` render the document" },
+    { STATS, "stats", 0, 0,          "write timings and counters to stderr" },
+    { STREAM, "stream", 0, 0,        "convert the input a piece at a time as it's read" },
     { 0, "help",   '?', 0,           "print a detailed usage message" },
 };
 #define NROPTS (sizeof opts/sizeof opts[0])
@@ -194,21 +786,19 @@ int
 main(int argc, char **argv)
 {
     int rc;
-    int debug = 0;
-    int toc = 0;
-    int content = 1;
     int version = 0;
-    int styles = 0;
     int use_mkd_line = 0;
-    int use_e_codefmt = 0;
-    int github_flavoured = 0;
-    int squash = 0;
-    char *extra_footnote_prefix = 0;
-    char *urlflags = 0;
+    int jobs = 0;
+    int from_list = 0;
+    char *serve_socket = 0;
+    char *client_socket = 0;
+    char *client_flags = 0;
+    int bitmap = 0;
     char *text = 0;
     char *ofile = 0;
-    char *urlbase = 0;
     char *q;
+    char **files;
+    int nrfiles, i;
     MMIOT *doc;
     struct h_context blob;
     struct h_opt *opt;
@@ -217,6 +807,9 @@ main(int argc, char **argv)
     if ( !flags )
 	perror("new_flags");
 
+    how.flags = flags;
+    how.content = 1;
+
     hoptset(&blob, argc, argv);
     hopterr(&blob, 1);
 
@@ -227,19 +820,23 @@ main(int argc, char **argv)
 
     while ( opt=gethopt(&blob, opts, NROPTS) ) {
 	if ( opt == HOPTERR ) {
-	    hoptusage(pgm, opts, NROPTS, "[file]");
+	    hoptusage(pgm, opts, NROPTS, "[file...]");
 	    exit(1);
 	}
 	switch (opt->optchar) {
 	case '5':   mkd_set_flag_num(flags, MKD_HTML5);
+		    if ( !clientflag(&client_flags, "html5") ) {
+			complain("out of memory");
+			exit(1);
+		    }
 		    break;
-	case 'b':   urlbase = hoptarg(&blob);
+	case 'b':   how.urlbase = hoptarg(&blob);
 		    break;
-	case 'd':   debug++;
+	case 'd':   how.debug++;
 		    break;
 	case 'V':   version++;
 		    break;
-	case 'E':   urlflags = hoptarg(&blob);
+	case 'E':   how.urlflags = hoptarg(&blob);
 		    break;
 	case 'f':   q = hoptarg(&blob);
 		    if ( strcmp(q, "?") == 0 ) {
@@ -252,6 +849,10 @@ main(int argc, char **argv)
 		    }
 		    else if ( q=mkd_set_flag_string(flags, hoptarg(&blob)) )
 			complain("unknown option <%s>", q);
+		    else if ( !clientflag(&client_flags, hoptarg(&blob)) ) {
+			complain("out of memory");
+			exit(1);
+		    }
 		    break;
 	case 'F':   q = hoptarg(&blob);
 		    if ( strcmp(q, "?") == 0 ) {
@@ -262,43 +863,70 @@ main(int argc, char **argv)
 			show_flags(0, version, flags);
 			exit(0);
 		    }
-		    else
+		    else {
 			mkd_set_flag_bitmap(flags,strtol(q, 0, 0));
+			bitmap = 1;
+		    }
+		    break;
+	case 'G':   how.github_flavoured = 1;
 		    break;
-	case 'G':   github_flavoured = 1;
+	case 'j':   q = hoptarg(&blob);
+		    if ( (jobs = atoi(q)) < 1 ) {
+			complain("bad job count <%s>", q);
+			exit(1);
+		    }
 		    break;
-	case 'n':   content = 0;
+	case 'n':   how.content = 0;
 		    break;
 	case 's':   text = hoptarg(&blob);
 		    break;
-	case 'S':   styles = 1;
+	case 'S':   how.styles = 1;
 		    break;
 	case 't':   text = hoptarg(&blob);
 		    use_mkd_line = 1;
 		    break;
 	case 'T':   mkd_set_flag_num(flags, MKD_TOC);
-		    toc = 1;
+		    how.toc = 1;
 		    break;
-	case 'C':   extra_footnote_prefix = hoptarg(&blob);
+	case 'C':   how.extra_footnote_prefix = hoptarg(&blob);
 		    break;
 	case 'o':   if ( ofile ) {
 			complain("Too many -o options");
 			exit(1);
 		    }
-		    if ( !freopen(ofile = hoptarg(&blob), "w", stdout) ) {
-			perror(ofile);
-			exit(1);
-		    }
+		    ofile = hoptarg(&blob);
 		    break;
-	case 'x':   squash = 1;
+	case 'x':   how.squash = 1;
 		    break;
-	case 'X':   use_e_codefmt = 1;
+	case 'X':   how.use_e_codefmt = 1;
 		    mkd_set_flag_num(flags, MKD_FENCEDCODE);
 		    external_formatter = hoptarg(&blob);
 		    fprintf(stderr, "selected external formatter (%s)\n", external_formatter);
 		    break;
-	case '?':   hoptdescribe(pgm, opts, NROPTS, "[file]", 1);
+	case '?':   hoptdescribe(pgm, opts, NROPTS, "[file...]", 1);
 		    return 0;
+	case 0:	    switch ( opt->option ) {
+		    case CODECACHE:
+			how.codecache_file = hoptarg(&blob);
+			break;
+		    case FROMLIST:
+			from_list = 1;
+			break;
+		    case SERVE:
+			serve_socket = hoptarg(&blob);
+			break;
+		    case CLIENT:
+			client_socket = hoptarg(&blob);
+			break;
+		    case STATS:
+			how.stats = 1;
+			mkd_stats_collect(1);
+			break;
+		    case STREAM:
+			how.stream = 1;
+			break;
+		    }
+		    break;
 	}
     }
 
@@ -314,12 +942,88 @@ main(int argc, char **argv)
     argc -= hoptind(&blob);
     argv += hoptind(&blob);
 
+    /* a streamed document is written as it's read, so there's no
+     * table of contents to put in front of it, and gfm documents
+     * aren't streamed at all
+     */
+    if ( how.stream && (how.toc || how.github_flavoured) ) {
+	complain("-stream can't be used with %s", how.toc ? "-T" : "-G");
+	exit(1);
+    }
+
+    if ( serve_socket ) {
+	rc = serve(serve_socket, jobs ? jobs : 4, serve_request);
+	mkd_free_flags(flags);
+	exit(rc);
+    }
+
+    if ( client_socket ) {
+	/* the daemon only hears about flags it can be sent by name;
+	 * -G and -T change how it reads and lays out the page, and
+	 * are up to whoever started it
+	 */
+	if ( bitmap || how.github_flavoured || how.toc ) {
+	    complain("-client can't be used with %s",
+		     bitmap ? "-F" : (how.github_flavoured ? "-G" : "-T"));
+	    exit(1);
+	}
+	if ( argc && !freopen(argv[0], "r", stdin) ) {
+	    perror(argv[0]);
+	    exit(1);
+	}
+	if ( ofile && !freopen(ofile, "w", stdout) ) {
+	    perror(ofile);
+	    exit(1);
+	}
+	rc = client(client_socket, client_flags, how.extra_footnote_prefix,
+		    stdin, stdout);
+	mkd_free_flags(flags);
+	exit(rc);
+    }
+
+    /* more than one file (or asking for workers or a list of files)
+     * means converting each file to its own html file.
+     */
+    if ( from_list || jobs || (argc > 1) ) {
+	if ( text ) {
+	    complain("-s and -t can't be used with multiple files");
+	    exit(1);
+	}
+	if ( from_list ) {
+	    files = readlist(&nrfiles);
+	    if ( argc )
+		complain("ignoring files on the command line");
+	}
+	else {
+	    files = argv;
+	    nrfiles = argc;
+	}
+
+	rc = batch(files, nrfiles, ofile, jobs ? jobs : 1);
+	if ( rc )
+	    complain("%d of %d file%s failed", rc, nrfiles, (nrfiles == 1) ? "" : "s");
+	if ( from_list ) {
+	    for ( i=0; i < nrfiles; i++ )
+		free(files[i]);
+	    if ( files )
+		free(files);
+	}
+	mkd_free_flags(flags);
+	adump();
+	exit( rc ? 1 : 0 );
+    }
+
+    if ( ofile && !freopen(ofile, "w", stdout) ) {
+	perror(ofile);
+	exit(1);
+    }
+
     if ( use_mkd_line )
 	rc = mkd_generateline( text, strlen(text), stdout, flags);
     else {
 	if ( text ) {
-	    doc = github_flavoured ? gfm_string(text, strlen(text), flags)
-				   : mkd_string(text, strlen(text), flags) ;
+	    doc = how.github_flavoured ? gfm_string(text, strlen(text), flags)
+				       : mkd_string(text, strlen(text), flags) ;
 
 	    if ( !doc ) {
 		perror(text);
@@ -332,45 +1036,24 @@ main(int argc, char **argv)
 		exit(1);
 	    }
 
-	    doc = github_flavoured ? gfm_in(stdin,flags)
-				   : mkd_in(stdin,flags);
+	    if ( how.github_flavoured )
+		doc = gfm_in(stdin,flags);
+	    else if ( how.stream )
+		doc = mkd_stream_in(stdin,flags);
+	    else
+		doc = mkd_in(stdin,flags);
 	    if ( !doc ) {
 		perror(argc ? argv[0] : "stdin");
 		exit(1);
 	    }
 	}
-	if ( urlbase )
-	    mkd_basename(doc, urlbase);
-
-	if ( urlflags )
-	    mkd_e_flags(doc, e_flags, NULL, urlflags);
-
-	if ( squash )
-	    mkd_e_anchor(doc, (mkd_callback_t) anchor_format, callback_free, 0);
-
-	if ( use_e_codefmt )
-	    mkd_e_code_format(doc, (mkd_callback_t)external_codefmt, callback_free, 0);
-
 
-	if ( extra_footnote_prefix )
-	    mkd_ref_prefix(doc, extra_footnote_prefix);
-
-	if ( debug ) {
-	    rc = mkd_dump(doc, stdout, flags, argc ? basename(argv[0]) : "stdin");
-	}
-	else {
-	    rc = 1;
-	    if ( mkd_compile(doc, flags) ) {
-		rc = 0;
-		if ( styles )
-		    mkd_generatecss(doc, stdout);
-		if ( toc )
-		    mkd_generatetoc(doc, stdout);
-		if ( content )
-		    mkd_generatehtml(doc, stdout);
-	    }
-	}
+	rc = render(doc, stdout, argc ? basename(argv[0]) : "stdin",
+		    flags, how.extra_footnote_prefix);
 	mkd_cleanup(doc);
+
+	if ( how.codecache )
+	    close_codecache(how.codecache, how.codecache_file);
     }
     mkd_free_flags(flags);
     adump();
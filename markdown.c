@@ -167,6 +167,8 @@ splitline(Line *t, int cutpoint)
 
 	tmp->next = t->next;
 	t->next = tmp;
+	tmp->lineno = t->lineno;
+	tmp->cut = 1;
 
 	SUFFIX(tmp->text, T(t->text)+cutpoint, S(t->text)-cutpoint);
 	COMPLETE(tmp->text);
@@ -1139,6 +1141,7 @@ addfootnote(Line *p, MMIOT* f)
     CREATE(foot->title);
     foot->fn_flags = 0;
     foot->text = 0;
+    foot->lineno = p->lineno;
     CREATE(foot->height);
     CREATE(foot->width);
     CREATE(foot->extended_attr);
@@ -1254,29 +1257,83 @@ consume(Line *ptr, int *eaten)
 }
 
 
+/*
+ * compile the source blocks that ___mkd_compile_region() set aside.
+ * They don't share anything but the (read-only by now) flags, so
+ * they can be compiled on as many threads as the document wants.
+ */
+struct sources {
+    STRING(Paragraph*) para;
+    MMIOT *f;
+};
+
+static void
+compile_source(int i, void *ctx)
+{
+    struct sources *src = ctx;
+    Paragraph *p = T(src->para)[i];
+
+    p->down = compile(p->text, 1, src->f);
+    p->text = 0;
+}
+
+
+static void
+compile_sources(Paragraph *p, MMIOT *f)
+{
+    struct sources src;
+    Paragraph *q;
+
+    if ( f->threads > 1 ) {
+	CREATE(src.para);
+	src.f = f;
+	for ( q = p; q; q = q->next )
+	    if ( (q->typ == SOURCE) && q->text )
+		EXPAND(src.para) = q;
+	___mkd_parallel(f->threads, S(src.para), compile_source, &src);
+	DELETE(src.para);
+    }
+
+    /* and whatever wasn't done in parallel gets done here
+     */
+    for ( ; p; p = p->next )
+	if ( (p->typ == SOURCE) && p->text ) {
+	    p->down = compile(p->text, 1, f);
+	    p->text = 0;
+	}
+}
+
+
 typedef ANCHOR(Line) Cache;
 
 static void
-uncache(Cache *cache, ParagraphRoot *d, MMIOT *f)
+uncache(Cache *cache, ParagraphRoot *d, MMIOT *f, int *open_fence)
 {
     Paragraph *p;
 
     if ( T(*cache) ) {
 	E(*cache)->next = 0;
 	p = Pp(d, 0, SOURCE);
-	p->down = compile(T(*cache), 1, f);
+	p->lineno = T(*cache)->cut ? -1 : T(*cache)->lineno;
+	if ( *open_fence )
+	    p->para_flags |= OPEN_FENCE;
+	p->text = T(*cache);	/* compiled by compile_sources() */
 	T(*cache) = E(*cache) = 0;
     }
+    *open_fence = 0;
 }
 
 
 /*
  * top-level compilation; break the document into
  * style, html, and source blocks with footnote links
- * weeded out.
+ * weeded out.   If we're given a resync list, stop at
+ * the first line on it where we'd start a new block
+ * from scratch (so mkd_update() can reuse the rest of
+ * the old document from there.)
  */
-static Paragraph *
-compile_document(Line *ptr, MMIOT *f)
+Paragraph *
+___mkd_compile_region(Line *ptr, MMIOT *f, struct resync *resync)
 {
     ParagraphRoot d = { 0, 0 };
     Cache source = { 0, 0 };
@@ -1284,25 +1341,41 @@ compile_document(Line *ptr, MMIOT *f)
     struct kw *tag;
     int eaten, unclosed;
     int previous_was_break = 1;
+    int open_fence = 0;
+    int next = 0;
+
+    if ( resync )
+	resync->stopped = -1;
 
     while ( ptr ) {
+	if ( resync ) {
+	    while ( (next < resync->count) && (resync->at[next] < ptr->lineno) )
+		++next;
+	    if ( (next < resync->count) && (resync->at[next] == ptr->lineno) && !ptr->cut
+		 && ( (previous_was_break && !T(source))
+		      || (!is_flag_set(&(f->flags), MKD_NOHTML) && isopentag(f, ptr)) ) ) {
+		resync->stopped = next;
+		___mkd_freeLines(ptr);
+		break;
+	    }
+	}
 	if ( !is_flag_set(&(f->flags), MKD_NOHTML) && (tag = isopentag(f, ptr)) ) {
 	    int blocktype;
-	    /* If we encounter a html/style block, compile and save all
+	    /* If we encounter a html/style block, set aside all
 	     * of the cached source BEFORE processing the html/style.
 	     */
-	    uncache(&source, &d, f);
+	    uncache(&source, &d, f, &open_fence);
 
 	    if ( is_flag_set(&(f->flags), MKD_NOSTYLE) || is_flag_set(&(f->flags), MKD_STRICT) )
 		blocktype = HTML;
 	    else
 		blocktype = strcmp(tag->id, "STYLE") == 0 ? STYLE : HTML;
 	    p = Pp(&d, ptr, blocktype);
+	    p->lineno = ptr->cut ? -1 : ptr->lineno;
 	    ptr = htmlblock(p, tag, &unclosed);
 	    if ( unclosed ) {
 		p->typ = SOURCE;
-		p->down = compile(p->text, 1, f);
-		p->text = 0;
+		p->para_flags |= OPEN_HTML;
 	    }
 	    previous_was_break = 1;
 	}
@@ -1325,9 +1398,10 @@ compile_document(Line *ptr, MMIOT *f)
 
 		/* dump out any previously cached text
 		 */
-		uncache(&source, &d, f);
+		uncache(&source, &d, f, &open_fence);
 
 		p = Pp(&d, ptr, FENCEDCODE);
+		p->lineno = ptr->cut ? -1 : ptr->lineno;
 
 		ptr = consume(last, &dummy);
 		previous_was_break = 1;
@@ -1339,6 +1413,9 @@ compile_document(Line *ptr, MMIOT *f)
 		ATTACH(source, ptr);
 		previous_was_break = 0;
 		ptr = ptr->next;
+		open_fence = 1;
+		if ( resync )
+		    resync->unterminated = 1;
 	    }
 	}
 	else {
@@ -1350,16 +1427,32 @@ compile_document(Line *ptr, MMIOT *f)
 	    ptr = ptr->next;
 	}
     }
-    /* if there's any cached source at EOF, compile
-     * it now.
+    /* if there's any cached source at EOF, set it aside
+     * with the rest, then compile all of it.
      */
-    uncache(&source, &d, f);
+    uncache(&source, &d, f, &open_fence);
+    compile_sources(T(d), f);
+
+    return T(d);
+}
+
+
+static Paragraph *
+compile_document(Line *ptr, MMIOT *f)
+{
+    ParagraphRoot d = { 0, 0 };
+
+    T(d) = ___mkd_compile_region(ptr, f, 0);
 
     /* if tables of contents are enabled, walk the document giving
      * all the headers unique labels
      */
-    if ( is_flag_set(&(f->flags), MKD_TOC) && !is_flag_set(&(f->flags), MKD_STRICT) )
+    if ( is_flag_set(&(f->flags), MKD_TOC) && !is_flag_set(&(f->flags), MKD_STRICT) ) {
+	double start = STAT_START(f);
+
 	___mkd_uniquify(&d, T(d));
+	STAT_TIME(f, toc, start);
+    }
 
     return T(d);
 }
@@ -1546,37 +1639,66 @@ compile(Line *ptr, int toplevel, MMIOT *f)
 int
 mkd_compile(Document *doc, mkd_flag_t* flags)
 {
+    double start;
+    struct acounts *charged;
+
     if ( !doc )
 	return 0;
 
     if ( doc->compiled ) {
 	if ( doc->dirty || DIFFERENT(flags, &doc->ctx->flags) ) {
-	    doc->compiled = doc->dirty = 0;
+	    doc->compiled = doc->dirty = doc->html = 0;
 	    if ( doc->code)
 		___mkd_freeParagraph(doc->code);
-	    if ( doc->ctx->footnotes )
-		___mkd_freefootnotes(doc->ctx);
+	    doc->code = 0;
+	    ___mkd_freemmiot(doc->ctx, 0);
 	}
 	else
 	    return 1;
     }
 
+    /* if we're keeping the source, compile a copy of it
+     */
+    if ( doc->source && !T(doc->content) )
+	T(doc->content) = __mkd_copy_lines(doc->source);
+    else if ( doc->edit && !T(doc->content) )
+	T(doc->content) = ___mkd_edit_lines(doc, doc->edit->header, S(doc->edit->line));
+
     doc->compiled = 1;
+    charged = ACHARGE(doc, A_COMPILE);
     
     ___mkd_initmmiot(doc->ctx, NULL, flags);
     
     doc->ctx->ref_prefix= doc->ref_prefix;
+    doc->ctx->seed      = doc->seed;
     doc->ctx->cb        = &(doc->cb);
+    doc->ctx->stats     = doc->stats;
+    doc->ctx->threads   = doc->threads;
 
     CREATE(doc->ctx->in);
 
     mkd_initialize();
 
+    if ( doc->stream ) {
+	/* streamed documents are compiled a piece at a time as
+	 * they're generated, so all we can do now is look for
+	 * the footnotes
+	 */
+	___mkd_stream_prescan(doc);
+	acharge(charged);
+	return 1;
+    }
+
+    start = STAT_START(doc);
     doc->code = compile_document(T(doc->content), doc->ctx);
+    STAT_TIME(doc, compile, start);
+    if ( doc->stats )
+	___mkd_stats_tree(doc->code, doc->stats);
     qsort(T(doc->ctx->footnotes->note), S(doc->ctx->footnotes->note),
 		        sizeof T(doc->ctx->footnotes->note)[0],
 			           (stfu)__mkd_footsort);
     memset(&doc->content, 0, sizeof doc->content);
+    acharge(charged);
     return 1;
 }
 
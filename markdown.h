@@ -53,6 +53,10 @@ enum {  MKD_NOLINKS=0,		/* don't do link processing, block <a> tags  */
 
 typedef struct { char bit[MKD_NR_FLAGS]; } mkd_flag_t;
 
+/* the structs that are handed back and forth with mkdio.h
+ */
+#include "mkdstructs.h"
+
 void mkd_init_flags(mkd_flag_t *p);
 
 #define is_flag_set(flags, item)	((flags)->bit[item])
@@ -89,6 +93,8 @@ typedef struct line {
     int is_fenced;		/* line inside a fenced code block (ick) */
     char *fence_class;		/* fenced code class (ick) */
     int count;
+    int lineno;			/* where it came from in the source */
+    int cut;			/* the end of a line that was split in two */
 } Line;
 
 
@@ -108,9 +114,16 @@ typedef struct paragraph {
 	   HDR, HR, TABLE, SOURCE } typ;
     enum { IMPLICIT=0, PARA, CENTER} align;
     int hnumber;		/* <Hn> for typ == HDR */
+    int lineno;			/* first source line (top-level blocks; -1
+				 * if it starts in the middle of a line) */
+    int id;			/* block id for mkd_block_changes() */
     int para_flags;
 #define GITHUB_CHECK		0x01
 #define IS_CHECKED		0x02
+#define OPEN_FENCE		0x04	/* (top-level) has a code fence that
+					 * was never closed */
+#define OPEN_HTML		0x08	/* (top-level) an html block that was
+					 * never closed */
 } Paragraph;
 
 typedef ANCHOR(Paragraph) ParagraphRoot;
@@ -130,6 +143,7 @@ typedef struct footnote {
     Cstring extended_attr;	/* extended attributes iff MKD_EXTENDED_ATTR */
     int dealloc;		/* deallocation needed? */
     int refnumber;
+    int lineno;			/* source line it was defined on */
     int fn_flags;
 #define EXTRA_FOOTNOTE	0x01
 #define REFERENCED	0x02
@@ -147,13 +161,31 @@ typedef struct block {
 typedef STRING(block) Qblock;
 
 
-typedef char* (*mkd_callback_t)(const char*, const int, void*);
-typedef void  (*mkd_free_t)(char*, void*);
+typedef struct mkd_callback One_callback;
 
-typedef struct {
-    mkd_callback_t func, free;
-    void *data;
-} One_callback;
+
+/* a memo of external code formatter results, keyed by a hash
+ * of the formatter identity, the language, and the code text.
+ */
+typedef struct codecache_entry {
+    struct codecache_entry *chain;	/* next entry in this hash bucket */
+    struct codecache_entry *older;	/* lru list, newest first */
+    struct codecache_entry *newer;
+    unsigned long hash;
+    Cstring key;			/* language, \0, code text */
+    Cstring fmt;			/* what the formatter made of it */
+} Codecache_entry;
+
+#define CODECACHE_BUCKETS	1024
+
+typedef struct codecache {
+    char *formatter;			/* formatter identity */
+    long maxbytes;			/* keep the cache under this size */
+    long bytes;				/* current size of keys + results */
+    long hits, misses;
+    Codecache_entry *newest, *oldest;
+    Codecache_entry *bucket[CODECACHE_BUCKETS];
+} Codecache;
 
 
 typedef struct {
@@ -161,9 +193,22 @@ typedef struct {
     One_callback e_flags;	/* extra href flags callback */
     One_callback e_anchor;	/* callback for anchor types */
     One_callback e_codefmt;	/* codeblock formatter (for highlighting) */
+    Codecache *codecache;	/* memoized e_codefmt results */
 } Callback_data;
 
 
+/* what mkd_block_changes() returned last time
+ */
+struct blocklist {
+    Cstring html;			/* the html it was in */
+    STRING(struct mkd_block) last;	/* (pointing into html) */
+    STRING(struct mkd_block) now;	/* what we're handing back */
+    STRING(Paragraph*) para;		/* and the blocks they came from */
+    STRING(char) live;			/* which ids are still in use */
+    int nextid;
+} ;
+
+
 struct escaped { 
     char *text;
     struct escaped *up;
@@ -187,6 +232,20 @@ struct kw {
 
 
 
+/* the runs of ` (or ~ or $) in an input buffer, so a span can find
+ * the run that closes it without scanning for it
+ */
+struct tickruns {
+    int size;			/* how much input it was built for */
+    STRING(int) start;		/* where each run starts */
+    STRING(int) len;		/* and how long it is */
+    STRING(int) least;		/* the shortest run from here on */
+    STRING(int) bylen;		/* the runs, by length and then position */
+    STRING(int) first;		/* where each length starts in bylen */
+    int next;			/* the run after the last one looked at */
+} ;
+
+
 /* a magic markdown io thing holds all the data structures needed to
  * do the backend processing of a markdown document
  */
@@ -198,14 +257,31 @@ typedef struct mmiot {
     int isp;
     struct escaped *esc;
     char *ref_prefix;
+    unsigned long seed;			/* for mangling email addresses */
     struct footnote_list *footnotes;
     mkd_flag_t flags;
 
     Callback_data *cb;
     STRING(struct kw) extratags;	/* extra (mainly html5) tags */
+    struct mkd_stats *stats;		/* (if collecting) the document's statistics */
+    int threads;			/* how many threads to compile with */
+    STRING(int) match[3];		/* (when they're needed) where the [, (, */
+					/* and { in the input close */
+    int lastparen;			/* and where the last ) is */
+    struct tickruns ticks[3];		/* (likewise) the runs of `, ~, and $ */
 } MMIOT;
 
 
+/* statistics collection.  These work on anything with a ->stats
+ * pointer, and only cost a pointer test if we're not collecting.
+ */
+#define STAT_ADD(x,field,n)	( (x)->stats ? ((x)->stats->field += (n)) : 0 )
+#define STAT_PEAK(x,field,n)	( ((x)->stats && ((n) > (x)->stats->field)) \
+					? ((x)->stats->field = (n)) : 0 )
+#define STAT_START(x)		( (x)->stats ? ___mkd_clock() : 0 )
+#define STAT_TIME(x,field,t)	( (x)->stats ? ((x)->stats->field += ___mkd_clock() - (t)) : 0 )
+
+
 #define MKD_EOLN	'\r'
 
 
@@ -229,10 +305,83 @@ typedef struct document {
     int html;			/* set after (internal) htmlify() */
     int tabstop;		/* for properly expanding tabs (ick) */
     char *ref_prefix;
+    unsigned long seed;		/* (optional) for mangling email addresses */
     MMIOT *ctx;			/* backend buffers, flags, and structures */
     Callback_data cb;		/* callback functions & private data */
+    struct mkd_stats *stats;	/* (optional) timings and counters */
+    struct acounts *alloc;	/* (if accounting) allocations by phase */
+    Cstring serial;		/* mkd_serialize() output */
+    Line *source;		/* (optional) copy of content for recompiling */
+    struct mkd_edit *edit;	/* (optional) source text for mkd_update() */
+    struct blocklist *blocks;	/* (optional) for mkd_block_changes() */
+    int threads;		/* compile & generate on this many threads */
+    struct mkd_stream *stream;	/* (optional) input that's compiled as it's
+				 * generated */
 } Document;
 
+/* the text of a document that's being changed with mkd_update(), with
+ * the offset of every line in it
+ */
+struct mkd_edit {
+    Cstring text;
+    STRING(int) line;
+    mkd_flag_t flags;		/* the flags it was read with */
+    int header;			/* # of lines in the pandoc header */
+};
+
+/* places where mkd_update() can stop recompiling a document and reuse
+ * the rest of the old one
+ */
+struct resync {
+    int *at;			/* (new) line #s of the old top-level blocks */
+    int count;
+    int stopped;		/* index into at[] where we stopped, or -1 */
+    int unterminated;		/* saw a code fence that wasn't closed */
+};
+
+/* the toc labels that have been handed out so far, hashed so a new
+ * one can be made unique without comparing it to all of them (see
+ * toc.c)
+ */
+struct label {
+    struct label *chain;
+    char *name;
+    int next;			/* the next _%d suffix to try on it */
+};
+
+typedef struct {
+    struct label **bucket;
+    int nrbuckets;
+    int count;
+} Labels;
+
+/* the input of a document that's read, compiled, and generated a
+ * piece at a time (see stream.c)
+ */
+struct mkd_stream {
+    FILE *input;
+    long start;			/* where the body starts (-1 if we can't
+				 * seek back to it) */
+    Cstring text;		/* what's been read but not compiled */
+    int cut;			/* where text can be cut (0 if nowhere) */
+    int maybe;			/* where it can be cut if the next block
+				 * isn't a definition */
+    int after;			/* seen a blank line after maybe */
+    int blank;			/* the last line read was blank */
+    int lead;			/* the first character of the last line
+				 * that wasn't */
+    int eof;
+    int gap;			/* the html so far needs a blank line
+				 * before the next block */
+    int prescanned;		/* the footnotes were found beforehand */
+    Labels labels;		/* toc labels used so far */
+};
+
+/* allocation accounting phases
+ */
+enum { A_INGEST=0, A_COMPILE, A_GENERATE, A_PHASES };
+#define ACHARGE(d,phase)	acharge( (d)->alloc ? &((d)->alloc[phase]) : 0 )
+
 
 /*
  * economy FILE-type structure for pulling characters out of a
@@ -266,6 +415,8 @@ extern int  mkd_firstnonblank(Line *);
 extern int  mkd_compile(Document *, mkd_flag_t*);
 extern int  mkd_document(Document *, char **);
 extern int  mkd_generatehtml(Document *, FILE *);
+typedef int (*mkd_sink_t)(const char*, int, void*);
+extern int  mkd_generate_to(Document *, mkd_sink_t, void *);
 extern int  mkd_css(Document *, char **);
 extern int  mkd_generatecss(Document *, FILE *);
 #define mkd_style mkd_generatecss
@@ -283,6 +434,7 @@ extern void mkd_string_to_anchor(char*,int, mkd_sta_function_t, void*, int, MMIO
 
 extern Document *mkd_in(FILE *, mkd_flag_t*);
 extern Document *mkd_string(const char*, int, mkd_flag_t*);
+extern Document *mkd_stream_in(FILE *, mkd_flag_t*);
 
 extern Document *gfm_in(FILE *, mkd_flag_t*);
 extern Document *gfm_string(const char*,int, mkd_flag_t*);
@@ -290,6 +442,30 @@ extern Document *gfm_string(const char*,int, mkd_flag_t*);
 extern void mkd_initialize(void);
 
 extern void mkd_ref_prefix(Document*, char*);
+extern void mkd_email_seed(Document*, unsigned long);
+
+extern Codecache *mkd_codecache(long, char *);
+extern void mkd_free_codecache(Codecache *);
+extern int  mkd_codecache_load(Codecache *, FILE *);
+extern int  mkd_codecache_save(Codecache *, FILE *);
+extern void mkd_codecache_stats(Codecache *, long *, long *);
+extern void mkd_e_code_cache(Document *, Codecache *);
+
+extern void mkd_stats_collect(int);
+extern int  mkd_stats(Document *, struct mkd_stats *);
+extern int  mkd_generatestats(Document *, FILE *);
+extern int  mkd_allocstats(Document *, struct mkd_allocstats *);
+extern int  mkd_generateallocstats(Document *, FILE *);
+
+extern int  mkd_render_html(Document *, struct mkd_render_options *, char **);
+extern int  mkd_retain_source(Document *);
+extern Document *mkd_edit_string(const char *, int, mkd_flag_t *);
+extern int  mkd_update(Document *, int, int, const char *);
+extern int  mkd_block_changes(Document *, struct mkd_block **);
+extern int  mkd_threads(Document *, int);
+
+extern int  mkd_serialize(Document *, char **);
+extern Document *mkd_deserialize(const char *, int);
 
 /* internal resource handling functions.
  */
@@ -301,24 +477,52 @@ extern void ___mkd_freefootnotes(MMIOT *);
 extern void ___mkd_initmmiot(MMIOT *, void *, mkd_flag_t*);
 extern void ___mkd_freemmiot(MMIOT *, void *);
 extern void ___mkd_freeLineRange(Line *, Line *);
+extern Paragraph *___mkd_compile_region(Line *, MMIOT *, struct resync *);
+extern Line *___mkd_edit_lines(Document *, int, int);
+typedef int (*Blockmark)(Paragraph *, int, void *);	/* !0 to stop */
+extern int  ___mkd_document_blocks(Document *, Blockmark, void *);
+extern void ___mkd_forget_html(Document *);
+extern int  ___mkd_htmlify_piece(Paragraph *, MMIOT *, int, Blockmark, void *);
+extern void ___mkd_stream_prescan(Document *);
+extern int  ___mkd_stream_html(Document *, Blockmark, void *);
+typedef void (*Job)(int, void *);
+extern int  ___mkd_parallel(int, int, Job, void *);
 extern void ___mkd_xml(char *, int, FILE *);
+
+/* the bytes that need to be escaped in code, urls, or xml:  anything
+ * outside of lo..hi, and the (one to six) bytes in stop
+ */
+struct escapes {
+    unsigned char lo, hi;
+    char stop[7];
+} ;
+extern int  ___mkd_clean(char *, int, struct escapes *);
 extern void ___mkd_reparse(char *, int, mkd_flag_t*, MMIOT*, char*);
 extern void ___mkd_emblock(MMIOT*);
+extern char *___mkd_codecache_get(Codecache *, char *, char *, int);
+extern void ___mkd_codecache_put(Codecache *, char *, char *, int, char *, int);
 extern void ___mkd_tidy(Cstring *);
+extern void ___mkd_stats_new(Document *);
+extern void ___mkd_stats_tree(Paragraph *, struct mkd_stats *);
+extern double ___mkd_clock(void);
 
 extern Document *__mkd_new_Document(void);
 extern void __mkd_enqueue(Document*, Cstring *);
 extern void __mkd_trim_line(Line *, int);
+extern Line *__mkd_copy_lines(Line *);
 
 extern int  __mkd_io_strget(struct string_stream *);
 
 /* toc uniquifier
  */
 extern void ___mkd_uniquify(ParagraphRoot *, Paragraph *);
+extern void ___mkd_initlabels(Labels *);
+extern void ___mkd_freelabels(Labels *);
+extern char *___mkd_uniquelabel(Labels *, char *);
     
 /* utility function to do some operation and exit the current function
  * if it fails
  */
-#define DO_OR_DIE(op) if ( (op) == EOF ) return EOF; else 1
+#define DO_OR_DIE(op) if ( (op) == EOF ) return EOF; else (void)0
 
 #endif/*_MARKDOWN_D*/
@@ -38,6 +38,7 @@
 #include "amalloc.h"
 
 #include "gethopt.h"
+#include "buildcache.h"
 
 char *pgm = "mkd2html";
 
@@ -69,13 +70,14 @@ fail(char *why, ...)
 }
 
 
-enum { GFM, ADD_CSS, ADD_HEADER, ADD_FOOTER };
+enum { GFM, ADD_CSS, ADD_HEADER, ADD_FOOTER, CACHE };
 
 struct h_opt opts[] = {
     { GFM,           "gfm",'G', 0,       "Github style markdown" },
     { ADD_CSS,       "css", 0, "url",    "Additional css for this page" },
     { ADD_HEADER, "header", 0, "header", "Additional headers for this page" },
     { ADD_FOOTER, "footer", 0, "footer", "Additional footers for this page" },
+    { CACHE,       "cache", 0, 0,        "Don't rebuild the page if nothing has changed" },
 };
 #define NROPTS (sizeof opts/sizeof opts[0])
 
@@ -92,6 +94,8 @@ main(int argc, char **argv)
     MMIOT *mmiot;
     int i;
     int gfm = 0;
+    int cache = 0;
+    bc_hash key;
     FILE *input, *output; 
     STRING(char*) css, headers, footers;
     struct h_opt *res;
@@ -124,6 +128,9 @@ main(int argc, char **argv)
 	case GFM:
 	    gfm = 1;
 	    break;
+	case CACHE:
+	    cache = 1;
+	    break;
 	default:
 	    fprintf(stderr, "unknown option?\n");
 	    break;
@@ -138,6 +145,7 @@ main(int argc, char **argv)
     case 0:
 	input = stdin;
 	output = stdout;
+	cache = 0;
 	break;
     
     case 1:
@@ -166,6 +174,26 @@ main(int argc, char **argv)
 		*dot = 0;
 	    strcat(dest, ".html");
 	}
+	else
+	    cache = 0;
+
+	if ( cache ) {
+	    /* everything that goes into the page */
+	    key = bc_string(BC_START, markdown_version, strlen(markdown_version));
+	    key = bc_string(key, gfm ? "G" : "M", 1);
+	    for ( i=0; i < S(css); i++ )
+		key = bc_string(key, T(css)[i], 1+strlen(T(css)[i]));
+	    key = bc_string(key, "", 1);
+	    for ( i=0; i < S(headers); i++ )
+		key = bc_string(key, T(headers)[i], 1+strlen(T(headers)[i]));
+	    key = bc_string(key, "", 1);
+	    for ( i=0; i < S(footers); i++ )
+		key = bc_string(key, T(footers)[i], 1+strlen(T(footers)[i]));
+	    key = bc_file(key, source);
+
+	    if ( bc_fresh(dest, key) )
+		exit(0);
+	}
 
 	if ( (output = fopen(dest, "w")) == 0 )
 	    fail("can't write to %s", dest);
@@ -231,5 +259,13 @@ main(int argc, char **argv)
 		    "</html>\n");
     
     mkd_cleanup(mmiot);
+
+    if ( cache ) {
+	if ( fclose(output) == EOF )
+	    fail("can't write to %s", dest);
+	bc_record(dest, key);
+	if ( bc_save() == EOF )
+	    fail("can't write the build cache for %s", dest);
+    }
     exit(0);
 }
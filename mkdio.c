@@ -28,6 +28,7 @@ __mkd_new_Document(void)
     if ( ret ) {
 	if ( ret->ctx = calloc(sizeof(MMIOT), 1) ) {
 	    ret->magic = VALID_DOCUMENT;
+	    ___mkd_stats_new(ret);
 	    return ret;
 	}
 	free(ret);
@@ -74,6 +75,48 @@ __mkd_enqueue(Document* a, Cstring *line)
 }
 
 
+/* copy a list of lines
+ */
+Line *
+__mkd_copy_lines(Line *p)
+{
+    ANCHOR(Line) copy = { 0, 0 };
+    Line *q;
+
+    for ( ; p ; p = p->next ) {
+	if ( (q = malloc(sizeof *q)) == 0 )
+	    break;
+	memcpy(q, p, sizeof *q);
+	q->next = 0;
+	CREATE(q->text);
+	RESERVE(q->text, S(p->text)+1);
+	memcpy(T(q->text), T(p->text), S(p->text));
+	S(q->text) = S(p->text);
+	T(q->text)[S(q->text)] = 0;
+	if ( p->fence_class )
+	    q->fence_class = strdup(p->fence_class);
+	ATTACH(copy, q);
+    }
+    return T(copy);
+}
+
+
+/* keep a copy of the source of a document so it can be compiled
+ * again (with different flags) after mkd_compile() eats it
+ */
+int
+mkd_retain_source(Document *doc)
+{
+    if ( !doc || doc->compiled )
+	return EOF;
+
+    /* (editable documents already keep their text) */
+    if ( !(doc->source || doc->edit) )
+	doc->source = __mkd_copy_lines(T(doc->content));
+    return 0;
+}
+
+
 /* trim leading characters from a line, then adjust the dle.
  */
 void
@@ -101,12 +144,16 @@ populate(getc_func getc, void* ctx, mkd_flag_t *flags)
     Document *a = __mkd_new_Document();
     int c;
     int pandoc = 0;
+    double start;
+    struct acounts *charged;
 
     if ( flags && (is_flag_set(flags, MKD_NOHEADER) || is_flag_set(flags, MKD_STRICT)) )
 	pandoc= EOF;
 
     if ( !a ) return 0;
 
+    start = STAT_START(a);
+    charged = ACHARGE(a, A_INGEST);
 
     if ( flags && (is_flag_set(flags, MKD_TABSTOP) || is_flag_set(flags, MKD_STRICT)) )
 	a->tabstop = 4;
@@ -124,14 +171,17 @@ populate(getc_func getc, void* ctx, mkd_flag_t *flags)
 		    pandoc = EOF;
 	    }
 	    __mkd_enqueue(a, &line);
+	    STAT_ADD(a, lines, 1);
 	    S(line) = 0;
 	}
 	else if ( (c & 0x80) || isprint(c) || isspace(c) )
 	    EXPAND(line) = c;
     }
 
-    if ( S(line) )
+    if ( S(line) ) {
 	__mkd_enqueue(a, &line);
+	STAT_ADD(a, lines, 1);
+    }
 
     DELETE(line);
 
@@ -149,6 +199,8 @@ populate(getc_func getc, void* ctx, mkd_flag_t *flags)
 	T(a->content) = headers->next->next->next;
     }
 
+    STAT_TIME(a, ingest, start);
+    acharge(charged);
     return a;
 }
 
@@ -207,6 +259,116 @@ mkd_generatehtml(Document *p, FILE *output)
 }
 
 
+/* streaming html:  a document's html is handed to a sink one block
+ * at a time as it's generated, so there's never more than the biggest
+ * block of it in memory.   The sink returns how much it took, and is
+ * handed the rest until it takes it all.   A sink that returns EOF
+ * (or takes nothing, which would otherwise have it called over and
+ * over forever) has failed, and nothing more is generated for it.
+ */
+struct sink {
+    Document *doc;
+    mkd_sink_t fn;
+    void *ctx;
+    int cdata;			/* xmlify the html on the way out */
+    int failed;
+    long written;		/* (unxmlified) bytes that went out */
+} ;
+
+
+static int
+sinkwrite(struct sink *s, char *text, int size)
+{
+    int did;
+
+    while ( size > 0 && !s->failed ) {
+	if ( (did = (*s->fn)(text, size, s->ctx)) <= 0 || did > size )
+	    s->failed = 1;
+	else {
+	    text += did;
+	    size -= did;
+	}
+    }
+    return s->failed ? EOF : 0;
+}
+
+
+static int
+sinkout(struct sink *s, char *text, int size)
+{
+    char *xml;
+    int szxml, rc;
+
+    s->written += size;
+    if ( !s->cdata )
+	return sinkwrite(s, text, size);
+
+    if ( (szxml = mkd_xml(text, size, &xml)) < 0 || !xml ) {
+	s->failed = 1;
+	return EOF;
+    }
+    rc = sinkwrite(s, xml, szxml);
+    free(xml);
+    return rc;
+}
+
+
+/* send the html for a block to the sink and clear it out of the
+ * document, or stop generating if the sink has failed
+ */
+static int
+sinkblock(Paragraph *p, int end, void *ctx)
+{
+    struct sink *s = ctx;
+    MMIOT *f = s->doc->ctx;
+
+    sinkout(s, T(f->out), end);
+    S(f->out) = 0;
+    return s->failed;
+}
+
+
+/* write the html to a sink, a block at a time
+ */
+int
+mkd_generate_to(Document *p, mkd_sink_t fn, void *ctx)
+{
+    struct sink s;
+    char *doc;
+    int szdoc;
+
+    if ( !(p && p->compiled && fn) )
+	return EOF;
+
+    s.doc = p;
+    s.fn = fn;
+    s.ctx = ctx;
+    s.cdata = is_flag_set( &(p->ctx->flags), MKD_CDATA );
+    s.failed = 0;
+    s.written = 0;
+
+    if ( p->html ) {
+	/* we've already got it, so there's no point generating it
+	 * again
+	 */
+	szdoc = mkd_document(p, &doc);
+	sinkout(&s, doc, szdoc);
+    }
+    else {
+	/* the html is thrown away as it's written, so what's left
+	 * at the end (the footnotes) has to be forgotten too
+	 */
+	szdoc = ___mkd_document_blocks(p, sinkblock, &s);
+	STAT_ADD(p, bytes_out, s.written);
+	sinkout(&s, T(p->ctx->out), szdoc);
+	___mkd_forget_html(p);
+    }
+    sinkwrite(&s, "\n", 1);
+
+    return s.failed ? EOF : 0;
+}
+
+
 /* convert some markdown text to html
  */
 int
@@ -376,7 +538,7 @@ mkd_generateline(char *bfr, int size, FILE *output, mkd_flag_t* flags)
 /* set the url display callback
  */
 void
-mkd_e_url(Document *f, mkd_callback_t edit, mkd_callback_t free, void *data)
+mkd_e_url(Document *f, mkd_callback_t edit, mkd_free_t free, void *data)
 {
     if ( f ) {
 	if ( f->cb.e_url.func != edit )
@@ -391,7 +553,7 @@ mkd_e_url(Document *f, mkd_callback_t edit, mkd_callback_t free, void *data)
 /* set the url options callback
  */
 void
-mkd_e_flags(Document *f, mkd_callback_t edit, mkd_callback_t free, void *data)
+mkd_e_flags(Document *f, mkd_callback_t edit, mkd_free_t free, void *data)
 {
     if ( f ) {
 	if ( f->cb.e_flags.func != edit )
@@ -406,7 +568,7 @@ mkd_e_flags(Document *f, mkd_callback_t edit, mkd_callback_t free, void *data)
 /* set the anchor formatter
  */
 void
-mkd_e_anchor(Document *f, mkd_callback_t format, mkd_callback_t free, void *data)
+mkd_e_anchor(Document *f, mkd_callback_t format, mkd_free_t free, void *data)
 {
     if ( f ) {
 	if ( f->cb.e_anchor.func != format )
@@ -421,7 +583,7 @@ mkd_e_anchor(Document *f, mkd_callback_t format, mkd_callback_t free, void *data
 /* set the code block display callback
  */
 void
-mkd_e_code_format(Document *f, mkd_callback_t codefmt, mkd_callback_t free, void *data)
+mkd_e_code_format(Document *f, mkd_callback_t codefmt, mkd_free_t free, void *data)
 {
     if ( f && (f->cb.e_codefmt.func != codefmt) ) {
 	f->dirty = 1;
@@ -444,6 +606,20 @@ mkd_ref_prefix(Document *f, char *data)
     }
 }
 
+
+/* set the seed that email addresses are mangled with (by default
+ * they're mangled the same way every time)
+ */
+void
+mkd_email_seed(Document *f, unsigned long seed)
+{
+    if ( f ) {
+	if ( f->seed != seed )
+	    f->dirty = 1;
+	f->seed = seed;
+    }
+}
+
 #if 0
 static void
 sayflags(char *pfx, mkd_flag_t* flags, FILE *output)
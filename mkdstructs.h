@@ -0,0 +1,83 @@
+/*
+ * the structs that are passed between the library and the programs
+ * that use it.  mkdio.h (for them) and markdown.h (for the library)
+ * both include this, so there's only one copy of each.  Whoever
+ * includes it has already said what a mkd_flag_t is.
+ */
+#ifndef _MKDSTRUCTS_D
+#define _MKDSTRUCTS_D
+
+/* a top-level block of a document's html, for mkd_block_changes()
+ */
+struct mkd_block {
+    int id;			/* stays the same while the block is there */
+    int changed;		/* html is different from last time */
+    char *html;
+    int size;
+} ;
+
+/* timings and counters (for documents created after
+ * mkd_stats_collect(1))
+ */
+struct mkd_stats {
+    double ingest;		/* seconds spent reading the source */
+    double compile;		/* ... building the paragraph tree */
+    double htmlify;		/* ... generating html */
+    double emblock;		/* ... resolving emphasis (part of htmlify) */
+    double toc;			/* ... building the table of contents */
+    long lines;			/* lines of source */
+    long paragraphs;		/* compiled paragraphs by type */
+    long headers;
+    long codeblocks;
+    long quotes;
+    long lists;
+    long listitems;
+    long htmlblocks;
+    long tables;
+    long rules;
+    long reparses;		/* fragments passed back through the inline parser */
+    long footnote_lookups;	/* searches of the footnote table */
+    long emphasis;		/* runs of * and _ queued for emblock */
+    long bytes_out;		/* size of the generated html */
+    long peak_in;		/* largest input to the inline parser */
+    long peak_out;		/* largest output buffer */
+} ;
+
+/* allocation counts (if the library was built with accounting)
+ */
+struct mkd_alloc_phase {
+    long allocs;		/* malloc()s and calloc()s */
+    long reallocs;		/* realloc()s */
+    long bytes;			/* bytes allocated */
+    long peak;			/* most bytes live at once */
+} ;
+
+struct mkd_allocstats {
+    struct mkd_alloc_phase ingest;	/* reading the source */
+    struct mkd_alloc_phase compile;	/* building the paragraph tree */
+    struct mkd_alloc_phase generate;	/* writing html, toc, and css */
+} ;
+
+/* callbacks (see mkd_e_url() &c), and the options for rendering a
+ * compiled document again with mkd_render_html()
+ */
+typedef char * (*mkd_callback_t)(const char*, const int, void*);
+typedef void   (*mkd_free_t)(char*, int, void*);
+
+struct mkd_callback {
+    mkd_callback_t func;
+    mkd_free_t free;
+    void *data;
+} ;
+
+struct mkd_render_options {
+    char *ref_prefix;			/* prefix for footnote ids */
+    mkd_flag_t *flags;			/* flags to add (MKD_CDATA, MKD_SAFELINK, ...) */
+    struct mkd_callback e_url;		/* see mkd_e_url() */
+    struct mkd_callback e_flags;	/* see mkd_e_flags() */
+    struct mkd_callback e_anchor;	/* see mkd_e_anchor() */
+    struct mkd_callback e_codefmt;	/* see mkd_e_code_format() */
+    void *codecache;			/* a mkd_codecache_t */
+} ;
+
+#endif/*_MKDSTRUCTS_D*/
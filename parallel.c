@@ -0,0 +1,123 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "config.h"
+
+#if USE_THREADS
+#include <pthread.h>
+#endif
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/*
+ * parallel documents:  the top level of a document is split into
+ * source, html, and fenced code blocks, and the footnotes and link
+ * definitions are pulled out of it, before anything is compiled
+ * (see ___mkd_compile_region()), so the source blocks can be
+ * compiled at the same time, and the paragraphs they compile to
+ * can be turned into html at the same time.
+ */
+#define MAXTHREADS	64
+
+/* how many threads to use on a document (1, if the library
+ * wasn't built with threads.)   Returns the number it'll use.
+ */
+int
+mkd_threads(Document *doc, int count)
+{
+    if ( !doc )
+	return EOF;
+#if USE_THREADS
+    doc->threads = (count < 1) ? 1 : (count > MAXTHREADS) ? MAXTHREADS : count;
+#else
+    doc->threads = 1;
+#endif
+    return doc->threads;
+}
+
+
+#if USE_THREADS
+struct crew {
+    pthread_mutex_t lock;
+    int next;
+    int count;
+    Job job;
+    void *ctx;
+};
+
+
+/* hand out jobs, one at a time, until they're all done
+ */
+static void *
+worker(void *arg)
+{
+    struct crew *crew = arg;
+    int i;
+
+    while ( 1 ) {
+	pthread_mutex_lock(&crew->lock);
+	i = crew->next++;
+	pthread_mutex_unlock(&crew->lock);
+
+	if ( i >= crew->count )
+	    break;
+	(*crew->job)(i, crew->ctx);
+    }
+    return 0;
+}
+#endif
+
+
+/* run job(0..count-1) on up to `threads` threads.   Returns 0 if it
+ * didn't (because there's only one thread or one job, or the library
+ * wasn't built with threads) and the caller should do it the
+ * old-fashioned way.
+ */
+int
+___mkd_parallel(int threads, int count, Job job, void *ctx)
+{
+#if USE_THREADS
+    pthread_t crew[MAXTHREADS];
+    struct crew work;
+    int i;
+
+    if ( threads > count )
+	threads = count;
+    if ( threads > MAXTHREADS )
+	threads = MAXTHREADS;
+    if ( threads < 2 )
+	return 0;
+
+    work.next = 0;
+    work.count = count;
+    work.job = job;
+    work.ctx = ctx;
+    if ( pthread_mutex_init(&work.lock, 0) != 0 )
+	return 0;
+
+    /* this thread is one of the workers, so if we can't start all of
+     * the others the work still gets done by the ones we did start
+     */
+    for ( i=0; i < threads-1; i++ )
+	if ( pthread_create(&crew[i], 0, worker, &work) != 0 )
+	    break;
+    worker(&work);
+
+    while ( i-- > 0 )
+	pthread_join(crew[i], 0);
+
+    pthread_mutex_destroy(&work.lock);
+    return 1;
+#else
+    return 0;
+#endif
+}
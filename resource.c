@@ -29,14 +29,18 @@ ___mkd_freeLine(Line *ptr)
 }
 
 
-/* free a list of lines
+/* free a list of lines (one at a time; a list can be as long
+ * as the document)
  */
 void
 ___mkd_freeLines(Line *p)
 {
-    if (p->next)
-	 ___mkd_freeLines(p->next);
-    ___mkd_freeLine(p);
+    Line *next;
+
+    for ( ; p; p = next ) {
+	next = p->next;
+	___mkd_freeLine(p);
+    }
 }
 
 
@@ -45,19 +49,22 @@ ___mkd_freeLines(Line *p)
 void
 ___mkd_freeParagraph(Paragraph *p)
 {
-    if (p->next)
-	___mkd_freeParagraph(p->next);
-    if (p->down)
-	___mkd_freeParagraph(p->down);
-    if (p->text)
-	___mkd_freeLines(p->text);
-    if (p->label)
-	free(p->label);
-    if (p->ident)
-	free(p->ident);
-    if (p->lang)
-	free(p->lang);
-    free(p);
+    Paragraph *next;
+
+    for ( ; p; p = next ) {
+	next = p->next;
+	if (p->down)
+	    ___mkd_freeParagraph(p->down);
+	if (p->text)
+	    ___mkd_freeLines(p->text);
+	if (p->label)
+	    free(p->label);
+	if (p->ident)
+	    free(p->ident);
+	if (p->lang)
+	    free(p->lang);
+	free(p);
+    }
 }
 
 
@@ -126,11 +133,23 @@ ___mkd_initmmiot(MMIOT *f, void *footnotes, mkd_flag_t *flags)
 void
 ___mkd_freemmiot(MMIOT *f, void *footnotes)
 {
+    int i;
+
     if ( f ) {
 	DELETE(f->in);
 	DELETE(f->out);
 	DELETE(f->Q);
 	DELETE(f->extratags);
+	DELETE(f->match[0]);
+	DELETE(f->match[1]);
+	DELETE(f->match[2]);
+	for ( i=0; i < 3; i++ ) {
+	    DELETE(f->ticks[i].start);
+	    DELETE(f->ticks[i].len);
+	    DELETE(f->ticks[i].least);
+	    DELETE(f->ticks[i].bylen);
+	    DELETE(f->ticks[i].first);
+	}
 	if ( f->footnotes != footnotes )
 	    ___mkd_freefootnotes(f);
 	
@@ -172,6 +191,28 @@ mkd_cleanup(Document *doc)
 	if ( doc->author) ___mkd_freeLine(doc->author);
 	if ( doc->date) ___mkd_freeLine(doc->date);
 	if ( T(doc->content) ) ___mkd_freeLines(T(doc->content));
+	if ( doc->source ) ___mkd_freeLines(doc->source);
+	if ( doc->edit ) {
+	    DELETE(doc->edit->text);
+	    DELETE(doc->edit->line);
+	    free(doc->edit);
+	}
+	if ( doc->blocks ) {
+	    DELETE(doc->blocks->html);
+	    DELETE(doc->blocks->last);
+	    DELETE(doc->blocks->now);
+	    DELETE(doc->blocks->para);
+	    DELETE(doc->blocks->live);
+	    free(doc->blocks);
+	}
+	if ( doc->stream ) {
+	    DELETE(doc->stream->text);
+	    ___mkd_freelabels(&doc->stream->labels);
+	    free(doc->stream);
+	}
+	if ( doc->stats ) free(doc->stats);
+	if ( doc->alloc ) free(doc->alloc);
+	DELETE(doc->serial);
 	memset(doc, 0, sizeof doc[0]);
 	free(doc);
     }
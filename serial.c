@@ -0,0 +1,474 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "config.h"
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/*
+ * serialized documents:  the compiled form of a document (the
+ * paragraph tree, the pandoc header, the footnotes, and the flags
+ * it was compiled with) written out as a flat string of bytes that
+ * doesn't contain any pointers, so it can be saved in a file, mmap()ed
+ * back in, or sent to another process and turned back into a document
+ * that's ready for mkd_document().
+ *
+ *   "DMKS" version
+ *   flags:	count, then the number of each flag that's set
+ *   tabstop
+ *   title, author, date:  lines
+ *   code:	paragraphs
+ *   footnotes:	reference, count, then each footnote
+ *
+ * Numbers are stored as little-endian base-128 varints (signed numbers
+ * zigzagged), strings as length+1 (0 for a null pointer) followed by
+ * the bytes, and lists of lines or paragraphs as a 1 before each item
+ * and a 0 at the end.
+ */
+#define SERIAL_MAGIC	"DMKS"
+#define SERIAL_VERSION	1
+
+typedef struct {
+    const unsigned char *p, *end;
+    int bad;
+} Reader;
+
+
+/* writing
+ */
+static void
+putnum(Cstring *out, unsigned long n)
+{
+    while ( n >= 0x80 ) {
+	EXPAND(*out) = (n & 0x7f) | 0x80;
+	n >>= 7;
+    }
+    EXPAND(*out) = n;
+}
+
+
+static void
+putint(Cstring *out, long n)
+{
+    putnum(out, (n < 0) ? ((~(unsigned long)n) << 1) | 1 : ((unsigned long)n) << 1);
+}
+
+
+static void
+putbytes(Cstring *out, char *s, int size)
+{
+    if ( s == 0 )
+	putnum(out, 0);
+    else {
+	putnum(out, size+1);
+	if ( size > 0 )
+	    SUFFIX(*out, s, size);
+    }
+}
+
+#define putstr(out,s)	putbytes(out, s, (s) ? strlen(s) : 0)
+#define putcstr(out,c)	putbytes(out, T(c), S(c))
+
+
+static void
+putline(Cstring *out, Line *p)
+{
+    putcstr(out, p->text);
+    putint(out, p->dle);
+    putint(out, p->has_pipechar);
+    putint(out, p->is_checked);
+    putint(out, p->kind);
+    putint(out, p->section_break);
+    putint(out, p->is_fenced);
+    putstr(out, p->fence_class);
+    putint(out, p->count);
+}
+
+
+static void
+putlines(Cstring *out, Line *p)
+{
+    for ( ; p ; p = p->next ) {
+	putnum(out, 1);
+	putline(out, p);
+    }
+    putnum(out, 0);
+}
+
+
+static void
+putparagraphs(Cstring *out, Paragraph *p)
+{
+    for ( ; p ; p = p->next ) {
+	putnum(out, 1);
+	putint(out, p->typ);
+	putint(out, p->align);
+	putint(out, p->hnumber);
+	putint(out, p->para_flags);
+	putstr(out, p->label);
+	putstr(out, p->ident);
+	putstr(out, p->lang);
+	putlines(out, p->text);
+	putparagraphs(out, p->down);
+    }
+    putnum(out, 0);
+}
+
+
+static void
+putheader(Cstring *out, Line *p)
+{
+    if ( p ) {
+	putnum(out, 1);
+	putline(out, p);
+    }
+    else
+	putnum(out, 0);
+}
+
+
+static void
+putfootnote(Cstring *out, Footnote *f)
+{
+    putcstr(out, f->tag);
+    putcstr(out, f->link);
+    putcstr(out, f->title);
+    putcstr(out, f->height);
+    putcstr(out, f->width);
+    putcstr(out, f->extended_attr);
+    putint(out, f->refnumber);
+    putint(out, f->fn_flags);
+    putparagraphs(out, f->text);
+}
+
+
+/* serialize a compiled document into a buffer that belongs to
+ * the document (and stays around until mkd_cleanup())
+ */
+int
+mkd_serialize(Document *doc, char **res)
+{
+    Cstring *out;
+    int i, count;
+    struct footnote_list *notes;
+
+    if ( !(doc && res && doc->compiled) )
+	return EOF;
+
+    out = &doc->serial;
+    S(*out) = 0;
+
+    SUFFIX(*out, SERIAL_MAGIC, 4);
+    putnum(out, SERIAL_VERSION);
+
+    for ( count=i=0; i < MKD_NR_FLAGS; i++ )
+	if ( is_flag_set(&doc->ctx->flags, i) )
+	    count++;
+    putnum(out, count);
+    for ( i=0; i < MKD_NR_FLAGS; i++ )
+	if ( is_flag_set(&doc->ctx->flags, i) )
+	    putnum(out, i);
+
+    putint(out, doc->tabstop);
+    putheader(out, doc->title);
+    putheader(out, doc->author);
+    putheader(out, doc->date);
+    putparagraphs(out, doc->code);
+
+    notes = doc->ctx->footnotes;
+    putint(out, notes ? notes->reference : 0);
+    putnum(out, notes ? S(notes->note) : 0);
+    if ( notes )
+	for ( i=0; i < S(notes->note); i++ )
+	    putfootnote(out, &T(notes->note)[i]);
+
+    *res = T(*out);
+    return S(*out);
+}
+
+
+/* reading
+ */
+static unsigned long
+getnum(Reader *in)
+{
+    unsigned long n = 0;
+    int shift = 0;
+    unsigned char c;
+
+    do {
+	if ( in->p >= in->end || shift > 8*sizeof n ) {
+	    in->bad = 1;
+	    return 0;
+	}
+	c = *in->p++;
+	n |= (unsigned long)(c & 0x7f) << shift;
+	shift += 7;
+    } while ( c & 0x80 );
+
+    return n;
+}
+
+
+static long
+getint(Reader *in)
+{
+    unsigned long n = getnum(in);
+
+    return (n & 1) ? (long)~(n >> 1) : (long)(n >> 1);
+}
+
+
+/* read a string into a Cstring; the text is always null-terminated
+ * (outside the string) because the html generator likes to %s them.
+ */
+static void
+getcstr(Reader *in, Cstring *c)
+{
+    unsigned long size = getnum(in);
+
+    CREATE(*c);
+    if ( size-- == 0 || in->bad )
+	return;
+    if ( size > (in->end - in->p) || (T(*c) = malloc(size+1)) == 0 ) {
+	in->bad = 1;
+	return;
+    }
+    (*c).alloc = size+1;
+    memcpy(T(*c), in->p, size);
+    T(*c)[size] = 0;
+    S(*c) = size;
+    in->p += size;
+}
+
+
+static char *
+getstr(Reader *in)
+{
+    Cstring c;
+
+    getcstr(in, &c);
+    return T(c);
+}
+
+
+static Line *
+getaline(Reader *in)
+{
+    Line *p = calloc(1, sizeof *p);
+
+    if ( p == 0 ) {
+	in->bad = 1;
+	return 0;
+    }
+    getcstr(in, &p->text);
+    p->dle = getint(in);
+    p->has_pipechar = getint(in);
+    p->is_checked = getint(in);
+    p->kind = getint(in);
+    p->section_break = getint(in);
+    p->is_fenced = getint(in);
+    p->fence_class = getstr(in);
+    p->count = getint(in);
+
+    /* the generator believes all of these, so a line that couldn't
+     * have come out of the compiler makes the whole document bad
+     */
+    if ( (p->dle < 0) || (p->dle > S(p->text))
+		      || (p->count < 0)
+		      || (p->kind < chk_text) || (p->kind > chk_equal)
+		      || (p->has_pipechar & ~1) || (p->is_checked & ~1)
+		      || (p->section_break & ~1) || (p->is_fenced & ~1) )
+	in->bad = 1;
+    return p;
+}
+
+
+static Line *
+getlines(Reader *in)
+{
+    ANCHOR(Line) lines = { 0, 0 };
+    Line *p;
+
+    while ( !in->bad && getnum(in) ) {
+	if ( (p = getaline(in)) == 0 )
+	    break;
+	ATTACH(lines, p);
+    }
+    return T(lines);
+}
+
+
+/* does a paragraph look like something the compiler could have made?
+ * (the items in a list, and only them, are LISTITEMs)
+ */
+static int
+goodparagraph(Paragraph *p, int inlist)
+{
+    Line *t;
+
+    if ( (p->typ < WHITESPACE) || (p->typ > SOURCE)
+			       || (p->align < IMPLICIT) || (p->align > CENTER) )
+	return 0;
+    if ( (p->typ == HDR) ? ((p->hnumber < 1) || (p->hnumber > 6))
+			 : (p->hnumber != 0) )
+	return 0;
+
+    if ( (p->typ == LISTITEM) != inlist )
+	return 0;
+
+    /* most blocks are printed starting from their first line, and
+     * tables from their second one
+     */
+    switch ( p->typ ) {
+    case MARKUP:
+    case HDR:
+    case CODE:
+    case FENCEDCODE:
+	if ( !p->text )
+	    return 0;
+	break;
+    case TABLE:
+	if ( !(p->text && p->text->next) )
+	    return 0;
+	break;
+    default:
+	break;
+    }
+
+    /* and only a fence has a class */
+    for ( t = p->text; t; t = t->next )
+	if ( t->fence_class && (p->typ != FENCEDCODE) )
+	    return 0;
+    return 1;
+}
+
+
+static Paragraph *
+getparagraphs(Reader *in, int depth, int inlist)
+{
+    ParagraphRoot list = { 0, 0 };
+    Paragraph *p;
+
+    if ( depth > 1000 ) {
+	/* nothing we compile nests this deep */
+	in->bad = 1;
+	return 0;
+    }
+
+    while ( !in->bad && getnum(in) ) {
+	if ( (p = calloc(1, sizeof *p)) == 0 ) {
+	    in->bad = 1;
+	    break;
+	}
+	ATTACH(list, p);
+	p->typ = getint(in);
+	p->align = getint(in);
+	p->hnumber = getint(in);
+	p->para_flags = getint(in);
+	p->label = getstr(in);
+	p->ident = getstr(in);
+	p->lang = getstr(in);
+	p->text = getlines(in);
+	p->down = getparagraphs(in, depth+1,
+				(p->typ == UL) || (p->typ == OL)
+					       || (p->typ == AL) || (p->typ == DL));
+
+	if ( !in->bad && !goodparagraph(p, inlist) )
+	    in->bad = 1;
+    }
+    return T(list);
+}
+
+
+static Line *
+getheader(Reader *in)
+{
+    return getnum(in) ? getaline(in) : 0;
+}
+
+
+static void
+getfootnote(Reader *in, Footnote *f)
+{
+    getcstr(in, &f->tag);
+    getcstr(in, &f->link);
+    getcstr(in, &f->title);
+    getcstr(in, &f->height);
+    getcstr(in, &f->width);
+    getcstr(in, &f->extended_attr);
+    f->refnumber = getint(in);
+    f->fn_flags = getint(in);
+    f->text = getparagraphs(in, 0, 0);
+}
+
+
+/* build a compiled document out of a serialized one
+ */
+Document *
+mkd_deserialize(const char *buf, int size)
+{
+    Reader in;
+    Document *doc;
+    mkd_flag_t flags;
+    unsigned long i, count, flag;
+
+    if ( !buf || size < 5 || memcmp(buf, SERIAL_MAGIC, 4) != 0 )
+	return 0;
+
+    in.p = (const unsigned char*)buf + 4;
+    in.end = (const unsigned char*)buf + size;
+    in.bad = 0;
+
+    if ( getnum(&in) != SERIAL_VERSION )
+	return 0;
+
+    mkd_init_flags(&flags);
+    count = getnum(&in);
+    for ( i=0; i < count && !in.bad; i++ )
+	if ( (flag = getnum(&in)) < MKD_NR_FLAGS )
+	    set_mkd_flag(&flags, flag);
+	else
+	    in.bad = 1;
+
+    if ( in.bad || (doc = __mkd_new_Document()) == 0 )
+	return 0;
+
+    mkd_initialize();
+
+    ___mkd_initmmiot(doc->ctx, NULL, &flags);
+    doc->ctx->cb = &(doc->cb);
+    doc->ctx->stats = doc->stats;
+
+    doc->tabstop = getint(&in);
+    doc->title = getheader(&in);
+    doc->author = getheader(&in);
+    doc->date = getheader(&in);
+    doc->code = getparagraphs(&in, 0, 0);
+
+    doc->ctx->footnotes->reference = getint(&in);
+    count = getnum(&in);
+    for ( i=0; i < count && !in.bad; i++ ) {
+	Footnote *f = &EXPAND(doc->ctx->footnotes->note);
+
+	memset(f, 0, sizeof *f);
+	getfootnote(&in, f);
+    }
+
+    if ( in.bad || in.p != in.end ) {
+	mkd_cleanup(doc);
+	return 0;
+    }
+
+    doc->compiled = 1;
+    return doc;
+}
@@ -0,0 +1,440 @@
+/*
+ * serve:  keep markdown resident and render documents sent to it over
+ *         a unix domain socket (markdown -serve), and the client that
+ *         talks to it (markdown -client)
+ *
+ * Each request is a set of header lines, a blank line, then the
+ * markdown source:
+ *
+ *     flags: named flags (as in markdown -f) for this document
+ *     prefix: the markdown extra footnote prefix (as in markdown -C)
+ *     length: the size of the source, in bytes
+ *
+ * and the reply is
+ *
+ *     status: 0 if the document was rendered
+ *     length: the size of the html (or error message) that follows
+ *
+ * followed by a blank line and the html.   Only length is required,
+ * and a connection may be used for as many requests as the client
+ * likes (but a client that goes quiet for TIMEOUT seconds in the
+ * middle of one, or between them, or that stops reading the reply,
+ * is hung up on.)   If flags is given more than once they're all
+ * used;  any other header can only be given once.
+ */
+/*
+ * Copyright (C) 2026 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "cstring.h"
+#include "amalloc.h"
+
+#define MAXHEADER	1024
+#define MAXREQUEST	(64*1024*1024)
+#define TIMEOUT		30	/* seconds a client can keep a worker waiting */
+
+typedef int (*renderer)(char *, int, char *, char *, FILE *);
+
+extern void complain(char *, ...);
+
+static volatile sig_atomic_t stopping = 0;
+
+static void
+stop(int sig)
+{
+    stopping = 1;
+}
+
+
+/* read the header of a request (or reply).   Returns 1 if there
+ * is one, 0 at end of file, and EOF if it's garbage.
+ */
+static int
+readheader(FILE *in, Cstring *flags, Cstring *prefix, long *status, long *length)
+{
+    char line[MAXHEADER];
+    char *value;
+    int size, lines = 0, seen = 0;
+
+    *length = -1;
+    if ( status )
+	*status = 0;
+    if ( flags )
+	S(*flags) = 0;
+    if ( prefix )
+	S(*prefix) = 0;
+
+    while ( fgets(line, sizeof line, in) ) {
+	size = strlen(line);
+	if ( (size == 0) || (line[size-1] != '\n') )
+	    return EOF;
+	line[--size] = 0;
+
+	if ( size == 0 )
+	    return (*length >= 0) ? 1 : EOF;
+	++lines;
+
+	if ( (value = strchr(line, ':')) == 0 )
+	    return EOF;
+	*value++ = 0;
+	while ( *value == ' ' )
+	    ++value;
+
+#define ONCE(bit)	if ( seen & (bit) ) return EOF; else seen |= (bit)
+
+	if ( strcmp(line, "length") == 0 ) {
+	    ONCE(1);
+	    *length = atol(value);
+	}
+	else if ( status && (strcmp(line, "status") == 0) ) {
+	    ONCE(2);
+	    *status = atol(value);
+	}
+	else if ( flags && (strcmp(line, "flags") == 0) ) {
+	    /* flags: a, then flags: b is flags: a,b */
+	    if ( S(*flags) )
+		T(*flags)[S(*flags)-1] = ',';
+	    SUFFIX(*flags, value, strlen(value));
+	    EXPAND(*flags) = 0;
+	}
+	else if ( prefix && (strcmp(line, "prefix") == 0) ) {
+	    ONCE(4);
+	    SUFFIX(*prefix, value, strlen(value));
+	    EXPAND(*prefix) = 0;
+	}
+#undef ONCE
+    }
+    return lines ? EOF : 0;
+}
+
+
+/* send a reply, either the rendered html or an error message
+ */
+static int
+reply(FILE *out, int status, char *text, long size)
+{
+    if ( fprintf(out, "status: %d\nlength: %ld\n\n", status, size) < 0 )
+	return EOF;
+    if ( size && (fwrite(text, size, 1, out) != 1) )
+	return EOF;
+    return fflush(out);
+}
+
+
+/* answer requests on a connection until the client hangs up
+ *
+ * The source buffer, flag and prefix buffers, and the scratch
+ * file the html is rendered into belong to the worker and are
+ * reused for every request.
+ */
+static void
+connection(int fd, renderer render, FILE *scratch,
+		    Cstring *source, Cstring *flags, Cstring *prefix)
+{
+    FILE *in, *out;
+    long length, html;
+    int status, rc;
+    char *msg;
+    struct timeval timeout;
+
+    /* don't let a client that's gone quiet (or stopped reading)
+     * tie up a worker forever
+     */
+    timeout.tv_sec = TIMEOUT;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+
+    if ( (in = fdopen(fd, "r")) == 0 ) {
+	close(fd);
+	return;
+    }
+    if ( (fd = dup(fd)) < 0 || (out = fdopen(fd, "w")) == 0 ) {
+	if ( fd >= 0 )
+	    close(fd);
+	fclose(in);
+	return;
+    }
+
+    while ( (rc = readheader(in, flags, prefix, 0, &length)) == 1 ) {
+	if ( length > MAXREQUEST ) {
+	    msg = "request too large";
+	    reply(out, 1, msg, strlen(msg));
+	    break;
+	}
+
+	S(*source) = 0;
+	RESERVE(*source, length+1);
+	if ( length && (fread(T(*source), length, 1, in) != 1) )
+	    break;
+	S(*source) = length;
+
+	rewind(scratch);
+	status = (*render)(T(*source), length,
+			   S(*flags) ? T(*flags) : 0,
+			   S(*prefix) ? T(*prefix) : 0, scratch);
+	fflush(scratch);
+	html = ftell(scratch);
+	rewind(scratch);
+
+	RESERVE(*source, html+1);
+	if ( html && (fread(T(*source), html, 1, scratch) != 1) ) {
+	    msg = "cannot read rendered html";
+	    reply(out, 1, msg, strlen(msg));
+	    break;
+	}
+
+	if ( reply(out, status, T(*source), html) == EOF )
+	    break;
+    }
+    if ( rc == EOF ) {
+	msg = "bad request";
+	reply(out, 1, msg, strlen(msg));
+    }
+    fclose(in);
+    fclose(out);
+}
+
+
+/* a worker process;  accept connections on the (shared) listening
+ * socket and serve them until we're told to stop.
+ */
+static void
+worker(int listener, renderer render)
+{
+    FILE *scratch;
+    Cstring source, flags, prefix;
+    int fd;
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+
+    if ( (scratch = tmpfile()) == 0 ) {
+	complain("cannot create a scratch file: %s", strerror(errno));
+	exit(1);
+    }
+
+    CREATE(source);
+    CREATE(flags);
+    CREATE(prefix);
+
+    while ( 1 ) {
+	if ( (fd = accept(listener, 0, 0)) < 0 ) {
+	    if ( errno == EINTR || errno == ECONNABORTED )
+		continue;
+	    complain("accept: %s", strerror(errno));
+	    exit(1);
+	}
+	connection(fd, render, scratch, &source, &flags, &prefix);
+
+	/* don't let one big document pin the memory forever */
+	if ( ALLOCATED(source) > (1024*1024) ) {
+	    DELETE(source);
+	    CREATE(source);
+	}
+    }
+}
+
+
+static pid_t
+spawn(int listener, renderer render)
+{
+    pid_t child;
+
+    if ( (child = fork()) == 0 )
+	worker(listener, render);
+    else if ( child < 0 )
+	complain("fork: %s", strerror(errno));
+    return child;
+}
+
+
+/* is there a daemon listening at this address already?  If there's
+ * a socket there that nobody's listening on, it was left behind by
+ * one that didn't clean up after itself and is thrown away.
+ */
+static int
+listening(struct sockaddr_un *addr)
+{
+    struct stat st;
+    int fd, rc;
+
+    if ( (stat(addr->sun_path, &st) != 0) || !S_ISSOCK(st.st_mode) )
+	return 0;
+
+    if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 )
+	return 0;
+    rc = connect(fd, (struct sockaddr*)addr, sizeof *addr);
+    if ( (rc != 0) && (errno == ECONNREFUSED) )
+	unlink(addr->sun_path);
+    close(fd);
+    return rc == 0;
+}
+
+
+/* serve() -- listen on a unix domain socket and hand the connections
+ *            out to a pool of worker processes.  Workers that die are
+ *            replaced; SIGTERM or SIGINT shuts everything down.
+ */
+int
+serve(char *path, int workers, renderer render)
+{
+    struct sockaddr_un addr;
+    int listener, i, status;
+    pid_t *pool, child;
+    struct sigaction sa;
+
+    if ( strlen(path) >= sizeof addr.sun_path ) {
+	complain("%s: socket name too long", path);
+	return 1;
+    }
+    if ( workers < 1 )
+	workers = 1;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ( listening(&addr) ) {
+	complain("%s: already being served", path);
+	return 1;
+    }
+
+    if ( (listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+	|| bind(listener, (struct sockaddr*)&addr, sizeof addr) != 0
+	|| listen(listener, 64) != 0 ) {
+	complain("%s: %s", path, strerror(errno));
+	return 1;
+    }
+
+    if ( (pool = calloc(workers, sizeof pool[0])) == 0 ) {
+	complain("out of memory");
+	return 1;
+    }
+
+    /* no SA_RESTART, so a signal gets us out of wait() */
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, 0);
+    sigaction(SIGINT, &sa, 0);
+    fflush(stdout);
+    fflush(stderr);
+
+    for ( i=0; i < workers; i++ )
+	if ( (pool[i] = spawn(listener, render)) < 0 )
+	    break;
+
+    while ( !stopping ) {
+	if ( (child = wait(&status)) < 0 ) {
+	    if ( errno == EINTR )
+		continue;
+	    break;
+	}
+	for ( i=0; i < workers; i++ )
+	    if ( pool[i] == child ) {
+		pool[i] = 0;
+		if ( !stopping ) {
+		    complain("worker %ld died; restarting it", (long)child);
+		    pool[i] = spawn(listener, render);
+		}
+		break;
+	    }
+    }
+
+    for ( i=0; i < workers; i++ )
+	if ( pool[i] > 0 )
+	    kill(pool[i], SIGTERM);
+    while ( wait(&status) > 0 )
+	;
+
+    close(listener);
+    unlink(path);
+    free(pool);
+    return 0;
+}
+
+
+/* client() -- send a document to a markdown daemon and write
+ *             the html it sends back
+ */
+int
+client(char *path, char *flags, char *prefix, FILE *input, FILE *output)
+{
+    struct sockaddr_un addr;
+    Cstring source;
+    FILE *in, *out;
+    char buf[8192];
+    long status, length;
+    int fd, size;
+
+    if ( strlen(path) >= sizeof addr.sun_path ) {
+	complain("%s: socket name too long", path);
+	return 1;
+    }
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+	|| connect(fd, (struct sockaddr*)&addr, sizeof addr) != 0 ) {
+	complain("%s: %s", path, strerror(errno));
+	return 1;
+    }
+
+    CREATE(source);
+    while ( (size = fread(buf, 1, sizeof buf, input)) > 0 )
+	SUFFIX(source, buf, size);
+
+    in = fdopen(fd, "r");
+    out = fdopen(dup(fd), "w");
+
+    if ( !(in && out) ) {
+	complain("%s: %s", path, strerror(errno));
+	return 1;
+    }
+
+    if ( flags )
+	fprintf(out, "flags: %s\n", flags);
+    if ( prefix )
+	fprintf(out, "prefix: %s\n", prefix);
+    fprintf(out, "length: %d\n\n", S(source));
+    if ( S(source) )
+	fwrite(T(source), S(source), 1, out);
+    fflush(out);
+    DELETE(source);
+
+    if ( ferror(out) || (readheader(in, 0, 0, &status, &length) != 1) ) {
+	complain("%s: no reply", path);
+	return 1;
+    }
+
+    while ( (length > 0) && (size = fread(buf, 1, (length > sizeof buf) ? sizeof buf : length, in)) > 0 ) {
+	fwrite(buf, size, 1, status ? stderr : output);
+	length -= size;
+    }
+    if ( status )
+	putc('\n', stderr);
+
+    fclose(in);
+    fclose(out);
+    return (length > 0) ? 1 : status;
+}
@@ -0,0 +1,183 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "config.h"
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* documents only collect statistics if they were created while
+ * collection was turned on, so the cost of the (compiled in)
+ * instrumentation is one test of a null pointer per event.
+ */
+static int collecting = 0;
+
+void
+mkd_stats_collect(int on)
+{
+    collecting = on;
+}
+
+
+/* attach a statistics block to a new document (if we're collecting)
+ * and allocation counters (if the library is keeping them)
+ */
+void
+___mkd_stats_new(Document *doc)
+{
+    if ( collecting )
+	doc->stats = calloc(1, sizeof doc->stats[0]);
+#if defined(USE_AMALLOC) || defined(USE_ALLOC_STATS)
+    doc->alloc = calloc(A_PHASES, sizeof doc->alloc[0]);
+#endif
+}
+
+
+/* seconds on a clock that's good enough for timing phases
+ */
+double
+___mkd_clock(void)
+{
+#if HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+#else
+    return clock() / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+
+/* count the compiled paragraphs by type
+ */
+void
+___mkd_stats_tree(Paragraph *p, struct mkd_stats *st)
+{
+    for ( ; p ; p = p->next ) {
+	switch ( p->typ ) {
+	case MARKUP:	st->paragraphs++; break;
+	case HDR:	st->headers++;	  break;
+	case CODE:
+	case FENCEDCODE:st->codeblocks++; break;
+	case QUOTE:	st->quotes++;	  break;
+	case DL:
+	case UL:
+	case OL:
+	case AL:	st->lists++;	  break;
+	case LISTITEM:	st->listitems++;  break;
+	case HTML:
+	case STYLE:	st->htmlblocks++; break;
+	case TABLE:	st->tables++;	  break;
+	case HR:	st->rules++;	  break;
+	default:			  break;
+	}
+	if ( p->down )
+	    ___mkd_stats_tree(p->down, st);
+    }
+}
+
+
+/* copy out the statistics for a document
+ */
+int
+mkd_stats(Document *doc, struct mkd_stats *st)
+{
+    if ( !(doc && st && doc->stats) )
+	return EOF;
+
+    memcpy(st, doc->stats, sizeof *st);
+    return 0;
+}
+
+
+/* print the statistics for a document
+ */
+int
+mkd_generatestats(Document *doc, FILE *out)
+{
+    struct mkd_stats st;
+
+    if ( mkd_stats(doc, &st) == EOF )
+	return EOF;
+
+    fprintf(out, "ingest   %10.6f s\n", st.ingest);
+    fprintf(out, "compile  %10.6f s\n", st.compile);
+    fprintf(out, "htmlify  %10.6f s\n", st.htmlify);
+    fprintf(out, "emblock  %10.6f s\n", st.emblock);
+    fprintf(out, "toc      %10.6f s\n", st.toc);
+    fprintf(out, "lines %ld\n", st.lines);
+    fprintf(out, "paragraphs %ld headers %ld code %ld quotes %ld lists %ld "
+		 "items %ld html %ld tables %ld rules %ld\n",
+		 st.paragraphs, st.headers, st.codeblocks, st.quotes, st.lists,
+		 st.listitems, st.htmlblocks, st.tables, st.rules);
+    fprintf(out, "reparses %ld\n", st.reparses);
+    fprintf(out, "footnote lookups %ld\n", st.footnote_lookups);
+    fprintf(out, "emphasis tokens %ld\n", st.emphasis);
+    fprintf(out, "bytes out %ld\n", st.bytes_out);
+    fprintf(out, "peak input %ld\n", st.peak_in);
+    fprintf(out, "peak output %ld\n", st.peak_out);
+    mkd_generateallocstats(doc, out);
+    return 0;
+}
+
+
+static void
+phase(struct mkd_alloc_phase *to, struct acounts *from)
+{
+    to->allocs = from->allocs;
+    to->reallocs = from->reallocs;
+    to->bytes = from->bytes;
+    to->peak = from->peak;
+}
+
+
+/* copy out the allocation counts for a document
+ */
+int
+mkd_allocstats(Document *doc, struct mkd_allocstats *st)
+{
+    if ( !(doc && st && doc->alloc) )
+	return EOF;
+
+    phase(&st->ingest, &doc->alloc[A_INGEST]);
+    phase(&st->compile, &doc->alloc[A_COMPILE]);
+    phase(&st->generate, &doc->alloc[A_GENERATE]);
+    return 0;
+}
+
+
+static void
+printphase(FILE *out, char *name, struct mkd_alloc_phase *p)
+{
+    fprintf(out, "%-8s %8ld %8ld %10ld %10ld\n", name,
+		 p->allocs, p->reallocs, p->bytes, p->peak);
+}
+
+
+/* print the allocation counts for a document
+ */
+int
+mkd_generateallocstats(Document *doc, FILE *out)
+{
+    struct mkd_allocstats st;
+
+    if ( mkd_allocstats(doc, &st) == EOF )
+	return EOF;
+
+    fprintf(out, "%-8s %8s %8s %10s %10s\n", "alloc", "count",
+		 "realloc", "bytes", "peak");
+    printphase(out, "ingest", &st.ingest);
+    printphase(out, "compile", &st.compile);
+    printphase(out, "generate", &st.generate);
+    return 0;
+}
@@ -0,0 +1,367 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+typedef int (*stfu)(const void*,const void*);
+int __mkd_footsort(Footnote *, Footnote *);
+
+/*
+ * streamed documents:  a document that's too big to keep in memory
+ * is read, compiled, and generated a piece at a time.   The input is
+ * only cut where a paragraph starts from scratch (after a blank line,
+ * with a line that can't continue a list or a definition list), and
+ * a piece with an html block or code fence that doesn't end in it
+ * is put back and read again with more text after it, so each piece
+ * compiles to the same blocks it would in the whole document.
+ *
+ * Footnotes, like cats, sleep anywhere, so if the input can be
+ * rewound they're found by reading it once before anything is
+ * generated.   If it can't (it's a pipe) they're picked up as the
+ * pieces go by, and a link can only use a footnote that was defined
+ * before it (or in the same piece.)
+ */
+#define PIECE	16384		/* how much text to compile at once */
+
+
+/* can a line that comes after a blank line start a new block, or
+ * could it be part of the one before it?  Anything that might be a
+ * list item, a definition, a blockquote, a footnote, or code could
+ * be, so only lines that start with a letter (or utf-8 character),
+ * a digit, a header, or emphasis are safe to cut before.
+ */
+static int
+fresh(unsigned char *line)
+{
+    char *q;
+
+    strtoul((char*)line, &q, 10);
+    if ( (q > (char*)line) && (*q == '.') && isspace((unsigned char)q[1]) )
+	return 0;		/* 1. is a numbered list item */
+
+    if ( (line[0] < 0x80) && isalpha(line[0]) )
+	return !(line[1] == '.' && isspace(line[2]));
+    if ( (line[0] >= 0xC0) || isdigit(line[0]) || (line[0] == '#') )
+	return 1;
+    if ( line[0] && strchr("*_-+", line[0]) )
+	return !isspace(line[1]);
+    return 0;
+}
+
+
+/* read a line of input, noting the places where it can be cut
+ */
+static int
+readline(struct mkd_stream *s)
+{
+    int c, at = S(s->text), blank = 1;
+    unsigned char *line;
+
+    while ( (c = getc(s->input)) != EOF ) {
+	EXPAND(s->text) = c;
+	if ( c == '\n' )
+	    break;
+	if ( c > ' ' )
+	    blank = 0;
+    }
+    if ( c == EOF )
+	s->eof = 1;
+    if ( S(s->text) == at )
+	return 0;
+    COMPLETE(s->text);
+
+    line = (unsigned char*)T(s->text) + at;
+
+    if ( s->maybe ) {
+	/* a paragraph that's followed by a : line is a definition
+	 * list item, and if the last block was a definition list
+	 * it's part of that
+	 */
+	if ( blank )
+	    s->after = 1;
+	else if ( (line[strspn((char*)line, " ")] == ':')
+		    && (strspn((char*)line, " ") < 4)
+		    && isspace(line[1+strspn((char*)line, " ")]) )
+	    s->maybe = 0;
+	else if ( s->after ) {
+	    s->cut = s->maybe;
+	    s->maybe = 0;
+	}
+    }
+
+    /* and a fresh line after a blank line starts a new block, unless
+     * the blank line was eaten along with a footnote or indented
+     * text before it
+     */
+    if ( s->blank && (at > 0) && fresh(line) && !strchr(" \t[", s->lead) ) {
+	s->maybe = at;
+	s->after = 0;
+    }
+    if ( !(s->blank = blank) )
+	s->lead = line[0];
+    return 1;
+}
+
+
+/* did a piece of the document end in the middle of an html block
+ * or code fence?
+ */
+static int
+unfinished(Paragraph *p)
+{
+    for ( ; p; p = p->next )
+	if ( p->para_flags & (OPEN_FENCE|OPEN_HTML) )
+	    return 1;
+    return 0;
+}
+
+
+/* compile the next piece of a streamed document
+ */
+static Document *
+nextpiece(Document *doc)
+{
+    struct mkd_stream *s = doc->stream;
+    Document *piece;
+    mkd_flag_t flags;
+    int want = PIECE, need = 0, size;
+
+    /* the header's already been pulled off the front */
+    COPY_FLAGS(flags, doc->ctx->flags);
+    set_mkd_flag(&flags, MKD_NOHEADER);
+
+    while ( 1 ) {
+	while ( !s->eof && ((S(s->text) < want) || (s->cut <= need)) )
+	    readline(s);
+
+	if ( (size = s->eof ? S(s->text) : s->cut) == 0 )
+	    return 0;
+
+	if ( (piece = mkd_string(T(s->text), size, &flags)) == 0 )
+	    return 0;
+	piece->cb = doc->cb;
+	piece->threads = doc->threads;
+	mkd_compile(piece, &flags);
+
+	if ( s->eof || !unfinished(piece->code) ) {
+	    CLIP(s->text, 0, size);
+	    s->cut = 0;
+	    if ( s->maybe )
+		s->maybe -= size;
+	    return piece;
+	}
+
+	/* something started in this piece that doesn't end in it, so
+	 * put it back and try again with (at least twice) as much text
+	 */
+	mkd_cleanup(piece);
+	need = size;
+	want = 2 * S(s->text);
+    }
+}
+
+
+/* go back to the start of the input, if we can
+ */
+static int
+restart(struct mkd_stream *s)
+{
+    if ( (s->start < 0) || (fseek(s->input, s->start, SEEK_SET) != 0) )
+	return 0;
+
+    S(s->text) = 0;
+    s->cut = s->maybe = s->after = s->blank = s->eof = s->lead = 0;
+    return 1;
+}
+
+
+/* add the footnotes from a piece to the document's.   When we're
+ * looking for them before the document is generated they're sorted
+ * once they've all been found, but when they're found as it's
+ * generated they're put in their place as they come and the first
+ * definition of a footnote is the one that's used
+ */
+static void
+adopt(Document *doc, Document *piece, int prescan)
+{
+    struct footnote_list *to = doc->ctx->footnotes;
+    struct footnote_list *from = piece->ctx->footnotes;
+    Footnote *fn;
+    int i, lo, hi, mid, cmp;
+
+    if ( prescan ) {
+	if ( S(from->note) )
+	    SUFFIX(to->note, T(from->note), S(from->note));
+	S(from->note) = 0;
+	return;
+    }
+
+    for ( i=0; i < S(from->note); i++ ) {
+	fn = &T(from->note)[i];
+	for ( cmp = 1, lo = 0, hi = S(to->note); cmp && (lo < hi); ) {
+	    mid = (lo + hi) / 2;
+	    if ( (cmp = __mkd_footsort(fn, &T(to->note)[mid])) > 0 )
+		lo = mid + 1;
+	    else if ( cmp < 0 )
+		hi = mid;
+	}
+	if ( cmp == 0 )
+	    ___mkd_freefootnote(fn);
+	else {
+	    EXPAND(to->note);
+	    memmove(&T(to->note)[lo+1], &T(to->note)[lo],
+		    (S(to->note) - lo - 1) * sizeof T(to->note)[0]);
+	    T(to->note)[lo] = *fn;
+	}
+    }
+    S(from->note) = 0;
+}
+
+
+/* give the headers in a piece labels that weren't used by any of the
+ * pieces before it, the same way ___mkd_uniquify() does for a whole
+ * document
+ */
+static void
+relabel(struct mkd_stream *s, Paragraph *p)
+{
+    Paragraph *c;
+    char *name;
+
+    for ( ; p; p = p->next ) {
+	if ( p->typ != SOURCE )
+	    continue;
+	for ( c = p->down; c; c = c->next ) {
+	    if ( (c->typ != HDR) || !c->label )
+		continue;
+
+	    if ( (name = ___mkd_uniquelabel(&s->labels, T(c->text->text))) ) {
+		free(c->label);
+		c->label = name;
+	    }
+	}
+    }
+}
+
+
+/* read a streamed document without generating it, so all of its
+ * footnotes are there when it is
+ */
+void
+___mkd_stream_prescan(Document *doc)
+{
+    struct mkd_stream *s = doc->stream;
+    Document *piece;
+
+    s->prescanned = 0;
+    if ( !restart(s) )
+	return;
+
+    while ( piece = nextpiece(doc) ) {
+	adopt(doc, piece, 1);
+	mkd_cleanup(piece);
+    }
+    qsort(T(doc->ctx->footnotes->note), S(doc->ctx->footnotes->note),
+	  sizeof T(doc->ctx->footnotes->note)[0], (stfu)__mkd_footsort);
+    s->prescanned = 1;
+}
+
+
+/* read, compile, and generate a streamed document, a piece at a time
+ * (or until mark() says to stop, and then return nonzero)
+ */
+int
+___mkd_stream_html(Document *doc, Blockmark mark, void *ctx)
+{
+    struct mkd_stream *s = doc->stream;
+    Document *piece;
+    Paragraph *last;
+
+    if ( s->prescanned && !restart(s) )
+	return 0;
+
+    ___mkd_freelabels(&s->labels);
+    s->gap = 0;
+
+    while ( piece = nextpiece(doc) ) {
+	if ( !s->prescanned )
+	    adopt(doc, piece, 0);
+	if ( is_flag_set(&doc->ctx->flags, MKD_TOC) && !is_flag_set(&doc->ctx->flags, MKD_STRICT) )
+	    relabel(s, piece->code);
+
+	if ( ___mkd_htmlify_piece(piece->code, doc->ctx, s->gap, mark, ctx) ) {
+	    mkd_cleanup(piece);
+	    return 1;
+	}
+
+	/* an empty source block at the end of a piece is the front of
+	 * the one the next piece starts with, so there's no blank line
+	 * after it
+	 */
+	for ( last = piece->code; last && last->next; last = last->next )
+	    ;
+	s->gap = last && !((last->typ == SOURCE) && !last->down);
+	mkd_cleanup(piece);
+    }
+    return 0;
+}
+
+
+/* a document that's read from a file as it's generated
+ */
+Document *
+mkd_stream_in(FILE *input, mkd_flag_t *flags)
+{
+    Document *doc, *header;
+    struct mkd_stream *s;
+    long at;
+    int i, pandoc = 1;
+
+    if ( !input || (doc = __mkd_new_Document()) == 0 )
+	return 0;
+    if ( (s = calloc(1, sizeof *s)) == 0 ) {
+	mkd_cleanup(doc);
+	return 0;
+    }
+    doc->stream = s;
+    s->input = input;
+    CREATE(s->text);
+    ___mkd_initlabels(&s->labels);
+
+    if ( flags && (is_flag_set(flags, MKD_NOHEADER) || is_flag_set(flags, MKD_STRICT)) )
+	pandoc = 0;
+
+    /* a pandoc header is the first three lines, if they all
+     * start with %
+     */
+    for ( i=0; pandoc && (i < 3); i++ ) {
+	at = S(s->text);
+	if ( !readline(s) || (T(s->text)[at] != '%') || (T(s->text)[S(s->text)-1] != '\n') )
+	    pandoc = 0;
+    }
+    if ( pandoc && (header = mkd_string(T(s->text), S(s->text), flags)) ) {
+	doc->title = header->title;
+	doc->author = header->author;
+	doc->date = header->date;
+	header->title = header->author = header->date = 0;
+	mkd_cleanup(header);
+
+	S(s->text) = 0;
+	s->cut = s->maybe = s->after = s->blank = s->lead = 0;
+    }
+
+    at = ftell(input);
+    s->start = (at < 0) ? -1 : at - S(s->text);
+    return doc;
+}
@@ -23,5 +23,11 @@ try -fautolink 'parenthesised (url)' \
 
 try -fautolink 'token with trailing @' 'orc@' '<p>orc@</p>'
 
+try -fautolink 'link at the start of a word' \
+    'a.http://it' \
+    '<p>a.<a href="http://it">http://it</a></p>'
+
+try -fautolink 'no link in the middle of a word' 'ahttp://it' '<p>ahttp://it</p>'
+
 summary $0
 exit $rc
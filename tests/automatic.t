@@ -23,6 +23,8 @@ match '<mailto:orc@pell>' '<mailto:orc@pell>' '<a href='
 match '<mailto:orc@pell.com>' '<mailto:orc@pell.com>' '<a href='
 match '<mailto:orc@>' '<mailto:orc@>' '<a href='
 match '<mailto:@pell>' '<mailto:@pell>' '<a href='
+try 'mangled addresses are always the same' '<orc@pell.com>' \
+    '<p><a href="&#109;&#x61;&#x69;&#x6c;&#x74;&#x6f;&#58;&#x6f;&#x72;&#x63;&#64;&#x70;&#x65;&#108;&#x6c;&#x2e;&#x63;&#111;&#x6d;">&#111;&#x72;&#99;&#x40;&#112;&#x65;&#108;&#108;&#46;&#99;&#x6f;&#109;</a></p>'
 
 summary $0
 exit $rc
@@ -0,0 +1,68 @@
+. tests/functions.sh
+
+title "converting many files"
+
+rc=0
+MARKDOWN_FLAGS=
+
+DIR=batch.$$
+rm -rf $DIR
+mkdir -p $DIR/src/sub
+./echo '# one' > $DIR/src/one.text
+./echo '*two*' > $DIR/src/two.md
+./echo 'three' > $DIR/src/sub/three
+
+# check -- see if a generated file is what it should be
+check() {
+    try_header "$1"
+
+    if [ -r "$2" ]; then
+	Q=`cat "$2"`
+    else
+	Q="($2 is missing)"
+    fi
+
+    if [ "$3" = "$Q" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "wanted: $3"
+	./echo "got:    $Q"
+	rc=1
+    fi
+}
+
+./markdown $DIR/src/one.text $DIR/src/two.md
+check 'html is written beside the source' $DIR/src/one.html '<h1>one</h1>'
+check 'suffix is replaced' $DIR/src/two.html '<p><em>two</em></p>'
+
+./markdown -j 2 -o $DIR/out $DIR/src/one.text $DIR/src/two.md $DIR/src/sub/three
+check 'parallel workers' $DIR/out/$DIR/src/one.html '<h1>one</h1>'
+check 'output directory keeps subdirectories' $DIR/out/$DIR/src/sub/three.html '<p>three</p>'
+
+( ./echo $DIR/src/one.text ; ./echo $DIR/src/sub/three ) | ./markdown -from-list -o $DIR/list
+check 'file list from stdin' $DIR/list/$DIR/src/sub/three.html '<p>three</p>'
+
+./markdown -j 2 -o $DIR/bad $DIR/src/one.text $DIR/src/nothere $DIR/src/two.md 2>/dev/null
+./echo $? > $DIR/status
+check 'a missing file does not stop the batch' $DIR/bad/$DIR/src/two.html '<p><em>two</em></p>'
+check 'a missing file is an error' $DIR/status 1
+
+./markdown -o $DIR/same $DIR/src/one.text $DIR/src/two.md `pwd`/$DIR/src/two.md 2>/dev/null
+check 'an absolute path keeps its directories' $DIR/same/`pwd`/$DIR/src/two.html '<p><em>two</em></p>'
+
+./echo 'not one' > $DIR/src/one.md
+./markdown -o $DIR/clash $DIR/src/one.text $DIR/src/one.md 2>/dev/null
+./echo $? > $DIR/status
+check 'two files with the same html are an error' $DIR/status 1
+check 'the first of them is converted' $DIR/clash/$DIR/src/one.html '<h1>one</h1>'
+
+rm -rf $DIR
+
+summary $0
+exit $rc
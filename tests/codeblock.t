@@ -243,5 +243,10 @@ content
 content
 </code></p>'
 
+try 'escapes past the first few dozen bytes of a line' \
+'    if ( the_first_condition_in_this_line && the_second < the_third > 0 )' \
+'<pre><code>if ( the_first_condition_in_this_line &amp;&amp; the_second &lt; the_third &gt; 0 )
+</code></pre>'
+
 summary $0
 exit $rc
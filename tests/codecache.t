@@ -0,0 +1,92 @@
+. tests/functions.sh
+
+title "code formatter cache"
+
+rc=0
+MARKDOWN_FLAGS=
+
+CACHE=codecache.$$
+
+SRC='    echo hi
+
+text
+
+    echo hi'
+
+HTML='<pre><code>ECHO HI
+</code></pre>
+
+<p>text</p>
+
+<pre><code>ECHO HI
+</code></pre>'
+
+# cached -- format $2 with the formatter $3, and check that the output
+#           is $4 and that the cache statistics are $5
+cached() {
+    try_header "$1"
+
+    Q=`./echo "$2" | ./markdown -X "$3" -codecache $CACHE 2>$$.e`
+    S=`grep '^codecache:' $$.e`
+    rm -f $$.e
+
+    if [ "$4" = "$Q" -a "$5" = "$S" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "wanted: $5"
+	./echo "$4" | sed -e 's/^/	/'
+	./echo "got:    $S"
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+}
+
+rm -f $CACHE
+cached 'repeated blocks are formatted once' "$SRC" 'tr a-z A-Z' \
+	"$HTML" 'codecache: 1 hit, 1 miss'
+cached 'cache is kept between runs' "$SRC" 'tr a-z A-Z' \
+	"$HTML" 'codecache: 2 hits, 0 misses'
+cached 'cache is dropped for a new formatter' "$SRC" 'tr [:lower:] [:upper:]' \
+	"$HTML" 'codecache: 1 hit, 1 miss'
+rm -f $CACHE
+
+printf 'discount codecache 1\ntr a-z A-Z\n2147483600 0\n' > $CACHE
+cached 'a cache with impossible sizes is ignored' "$SRC" 'tr a-z A-Z' \
+	"$HTML" 'codecache: 1 hit, 1 miss'
+rm -f $CACHE
+
+# every worker's share of the cache is kept, not just the last one's
+DIR=codecache.d.$$
+rm -rf $DIR
+mkdir $DIR
+for x in a b c d; do
+    ./echo "    echo $x" > $DIR/$x.text
+done
+./markdown -X 'tr a-z A-Z' -codecache $CACHE -j 4 $DIR/*.text 2>/dev/null
+Q=`./markdown -X 'tr a-z A-Z' -codecache $CACHE -j 4 $DIR/*.text 2>&1 \
+	| sed -n -e 's/^codecache: \([0-9]*\) hits*,.*/\1/p' \
+	| awk '{ hits += $1 } END { print hits }'`
+try_header 'parallel workers share one cache'
+if [ "$Q" = 4 ]; then
+    __passed=`expr $__passed + 1`
+    test $VERBOSE && ./echo " ok"
+else
+    __failed=`expr $__failed + 1`
+    test $VERBOSE || ./echo
+    ./echo "parallel workers share one cache"
+    ./echo "wanted: 4 hits"
+    ./echo "got:    $Q hits"
+    rc=1
+fi
+rm -rf $DIR $CACHE
+
+summary $0
+exit $rc
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+char *sample = "# A header\n"
+	       "\n"
+	       "The first paragraph, with a [link][one].\n"
+	       "\n"
+	       "The second paragraph[^1].\n"
+	       "\n"
+	       "<div>\n"
+	       "html\n"
+	       "</div>\n"
+	       "\n"
+	       "* a list\n"
+	       "* with [another][one] link\n"
+	       "\n"
+	       "~~~\n"
+	       "code\n"
+	       "~~~\n"
+	       "\n"
+	       "The last paragraph.\n"
+	       "\n"
+	       "[one]: http://one\n"
+	       "[^1]: the footnote\n";
+
+char text[20000];
+
+struct mkd_block *blocks;
+int count;
+
+/* the ids and html of the blocks last time */
+struct { int id; char *html; int size; } last[1000];
+int nrlast;
+
+
+/* get the blocks, check that they add up to the whole document,
+ * and that the ones that aren't marked as changed didn't.
+ */
+void
+changes(MMIOT *doc, mkd_flag_t *flags, char *what)
+{
+    MMIOT *fresh;
+    char *html;
+    int i, j, size, pos;
+
+    if ( !mkd_compile(doc, flags) || (count = mkd_block_changes(doc, &blocks)) < 1 )
+	fail(what);
+
+    fresh = mkd_string(text, strlen(text), flags);
+    if ( !mkd_compile(fresh, flags) || (size = mkd_document(fresh, &html)) < 0 )
+	fail("fresh document");
+
+    for ( pos=i=0; i < count; i++ ) {
+	if ( (pos + blocks[i].size > size) || memcmp(html+pos, blocks[i].html, blocks[i].size) )
+	    fail(what);
+	pos += blocks[i].size;
+
+	for ( j=0; j < i; j++ )
+	    if ( blocks[i].id == blocks[j].id )
+		fail(what);
+
+	if ( !blocks[i].changed ) {
+	    for ( j=0; j < nrlast; j++ )
+		if ( last[j].id == blocks[i].id )
+		    break;
+	    if ( (j == nrlast) || (last[j].size != blocks[i].size)
+			       || memcmp(last[j].html, blocks[i].html, last[j].size) )
+		fail(what);
+	}
+    }
+    if ( (pos != size) || (blocks[count-1].id != 0) )
+	fail(what);
+
+    for ( j=0; j < nrlast; j++ )
+	free(last[j].html);
+    for ( nrlast=0; nrlast < count; nrlast++ ) {
+	last[nrlast].id = blocks[nrlast].id;
+	last[nrlast].size = blocks[nrlast].size;
+	last[nrlast].html = malloc(blocks[nrlast].size+1);
+	memcpy(last[nrlast].html, blocks[nrlast].html, blocks[nrlast].size);
+    }
+
+    mkd_cleanup(fresh);
+}
+
+
+int
+nrchanged()
+{
+    int i, changed = 0;
+
+    for ( i=0; i < count; i++ )
+	if ( blocks[i].changed )
+	    ++changed;
+    return changed;
+}
+
+
+/* which block has this text in it? */
+int
+find(char *what)
+{
+    int i, j, size = strlen(what);
+
+    for ( i=0; i < count; i++ )
+	for ( j=0; j + size <= blocks[i].size; j++ )
+	    if ( memcmp(blocks[i].html + j, what, size) == 0 )
+		return blocks[i].id;
+    return -1;
+}
+
+
+void
+edit(MMIOT *doc, char *where, int removed, char *insert)
+{
+    char *p = strstr(text, where);
+    int offset;
+
+    if ( !p )
+	fail(where);
+    offset = p - text;
+
+    if ( mkd_update(doc, offset, removed, insert) != 0 )
+	fail(where);
+    memmove(p+strlen(insert), p+removed, strlen(p+removed)+1);
+    memcpy(p, insert, strlen(insert));
+}
+
+
+static unsigned long state = 1;
+
+static int
+rnd(int n)
+{
+    state = state * 1103515245 + 12345;
+    return (int)((state >> 16) % n);
+}
+
+char *bits[] = { "\n", "\n\n", "~~~\n", "<div>\n", "</div>\n", "[one]: http://two\n",
+		 "[^1]: note\n", "# hdr\n", "* item\n", "> quote\n", "text ",
+		 "[one][]", "[^1]", "" };
+#define NRBITS	(sizeof bits / sizeof bits[0])
+
+
+int
+main()
+{
+    MMIOT *doc;
+    mkd_flag_t *flags = mkd_flags();
+    int id, first, second, i;
+    char *p;
+
+    say("check block changes: ");
+
+    mkd_set_flag_num(flags, MKD_FENCEDCODE);
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+
+    strcpy(text, sample);
+    if ( (doc = mkd_edit_string(text, strlen(text), flags)) == 0 )
+	fail("mkd_edit_string");
+
+    changes(doc, flags, "first");
+    if ( nrchanged() != count )
+	fail("first");
+    first = find("first paragraph");
+    second = find("second paragraph");
+
+    say("again ");
+    changes(doc, flags, "again");
+    if ( nrchanged() != 0 )
+	fail("again");
+
+    say("edit ");
+    edit(doc, "first paragraph", 5, "changed");
+    changes(doc, flags, "edit");
+    if ( (nrchanged() != 1) || (find("changed paragraph") != first) || (find("second paragraph") != second) )
+	fail("edit");
+
+    say("insert ");
+    edit(doc, "The second", 0, "A new paragraph.\n\n");
+    changes(doc, flags, "insert");
+    id = find("new paragraph");
+    if ( (nrchanged() != 1) || (id == first) || (id == second) || (find("second paragraph") != second) )
+	fail("insert");
+
+    say("delete ");
+    edit(doc, "A new paragraph.\n\n", 18, "");
+    changes(doc, flags, "delete");
+    if ( (nrchanged() != 0) || (find("second paragraph") != second) )
+	fail("delete");
+
+    say("reference ");
+    edit(doc, "http://one", 10, "http://uno");
+    changes(doc, flags, "reference");
+    if ( (nrchanged() != 2) || (find("uno") != first) )
+	fail("reference");
+
+    say("fuzz ");
+    for ( i=0; i < 500; i++ ) {
+	int size = strlen(text);
+	int offset = rnd(size+1);
+	int removed = rnd(4) ? 0 : rnd(size - offset + 1) % 40;
+	char *insert = bits[rnd(NRBITS)];
+
+	if ( size > 8000 )
+	    removed = size - offset;
+
+	if ( mkd_update(doc, offset, removed, insert) != 0 )
+	    fail("fuzz");
+	p = text + offset;
+	memmove(p+strlen(insert), p+removed, strlen(p+removed)+1);
+	memcpy(p, insert, strlen(insert));
+	changes(doc, flags, "fuzz");
+    }
+
+    mkd_cleanup(doc);
+    mkd_free_flags(flags);
+    say("ok\n");
+    exit(0);
+}
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+/* bits of markdown to glue together into documents big enough to be
+ * read a piece at a time
+ */
+char *bits[] = { "\n", "\n\n", "\n\nWord ", "\n\nterm\n:   definition\n", "~~~\ncode\n~~~\n",
+		 "<div>\nhtml\n</div>\n", "[one]: http://one\n", "[^1]: a footnote\n",
+		 "# hdr\n", "Setext\n======\n", "* item\n", "1. item\n", "a. item\n",
+		 "> quote\n", "    indented\n", "text ", "|a|b|\n|-|-|\n", "[one][] ",
+		 "[^1] ", "*em* ", "**strong", "`code` ", "-----\n",
+		 "\n\n\xd0\xa1\xd0\xbb\xd0\xbe\xd0\xb2\xd0\xbe ", "\n\n1999 ", "\n\n_em_ ",
+		 "\n\n2. item\n", "\n\n+ item\n", "\n\n-1. item\n" };
+#define NRBITS	(sizeof bits / sizeof bits[0])
+
+/* and the ones that can't be in the documents with toc labels */
+#define NOTOC(b)	((b)[0] == '~' || (b)[0] == '<')
+
+static unsigned long state = 1;
+
+static int
+rnd(int n)
+{
+    state = state * 1103515245 + 12345;
+    return (int)((state >> 16) % n);
+}
+
+
+char text[400000];
+
+
+/* build a random document (with the link definitions at the front of
+ * it, if they're wanted there)
+ */
+void
+build(int size, int toc, int before)
+{
+    char *bit, *end = text;
+
+    if ( before )
+	end = stpcpy(end, "[one]: http://one\n[^1]: a footnote\n\n");
+    while ( size-- > 0 ) {
+	bit = bits[rnd(NRBITS)];
+	if ( (toc && NOTOC(bit)) || (before && bit[0] == '[' && strchr(bit, ':')) )
+	    continue;
+	end = stpcpy(end, bit);
+    }
+    *end = 0;
+}
+
+
+char *
+whole(mkd_flag_t *flags)
+{
+    MMIOT *doc = mkd_string(text, strlen(text), flags);
+    char *res, *ret;
+
+    if ( !doc || !mkd_compile(doc, flags) || mkd_document(doc, &res) < 0 )
+	fail("mkd_string");
+    ret = malloc(strlen(res)+2);
+    sprintf(ret, "%s\n", res);
+    mkd_cleanup(doc);
+    return ret;
+}
+
+
+struct sink {
+    char *out;
+    int size;
+} sink;
+
+int
+tomemory(const char *text, int size, void *ctx)
+{
+    struct sink *s = ctx;
+
+    s->out = realloc(s->out, s->size + size + 1);
+    memcpy(s->out + s->size, text, size);
+    s->size += size;
+    s->out[s->size] = 0;
+    return size;
+}
+
+
+/* read the document a piece at a time from input
+ */
+char *
+pieces(FILE *input, mkd_flag_t *flags)
+{
+    MMIOT *doc = mkd_stream_in(input, flags);
+
+    if ( !doc || !mkd_compile(doc, flags) )
+	fail("mkd_stream_in");
+    sink.out = 0;
+    sink.size = 0;
+    if ( mkd_generate_to(doc, tomemory, &sink) != 0 )
+	fail("mkd_generate_to");
+    mkd_cleanup(doc);
+    return sink.out ? sink.out : strdup("");
+}
+
+
+char *
+fromfile(mkd_flag_t *flags)
+{
+    FILE *f = tmpfile();
+    char *ret;
+
+    if ( !f )
+	fail("tmpfile");
+    fputs(text, f);
+    rewind(f);
+    ret = pieces(f, flags);
+    fclose(f);
+    return ret;
+}
+
+
+char *
+frompipe(mkd_flag_t *flags)
+{
+    char name[] = "/tmp/piecesXXXXXX";
+    char command[80];
+    FILE *f, *p;
+    char *ret;
+    int fd;
+
+    if ( (fd = mkstemp(name)) < 0 || (f = fdopen(fd, "w")) == 0 )
+	fail("mkstemp");
+    fputs(text, f);
+    fclose(f);
+    sprintf(command, "cat %s", name);
+    if ( (p = popen(command, "r")) == 0 )
+	fail("popen");
+    ret = pieces(p, flags);
+    pclose(p);
+    remove(name);
+    return ret;
+}
+
+
+void
+same(char *a, char *b, char *what)
+{
+    if ( strcmp(a, b) != 0 ) {
+	fprintf(stderr, "text:\n%s\nwhole:\n%s\npieces:\n%s\n", text, a, b);
+	fail(what);
+    }
+    free(a);
+    free(b);
+}
+
+
+void
+compare(mkd_flag_t *flags, int count, int size, int toc, char *what)
+{
+    int i;
+
+    say(what);
+    say(" ");
+    for ( i=0; i < count; i++ ) {
+	build(size + rnd(3*size), toc, 0);
+	same(whole(flags), fromfile(flags), what);
+    }
+}
+
+
+int
+main()
+{
+    mkd_flag_t *flags = mkd_flags();
+    MMIOT *doc;
+    char *html;
+    FILE *f;
+
+    say("check pieces: ");
+
+    mkd_set_flag_num(flags, MKD_FENCEDCODE);
+    compare(flags, 10, 5000, 0, "markdown");
+
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+    mkd_set_flag_num(flags, MKD_DLEXTRA);
+    compare(flags, 10, 5000, 0, "footnotes");
+
+    /* (smaller, because there are so many headers with the same name) */
+    mkd_set_flag_num(flags, MKD_TOC);
+    compare(flags, 5, 1000, 1, "toc");
+    mkd_clr_flag_num(flags, MKD_TOC);
+
+    /* an html block that doesn't end until the end of the document */
+    say("unclosed ");
+    build(20000, 0, 0);
+    memmove(text+6, text, strlen(text)+1);
+    memcpy(text, "<div>\n", 6);
+    strcat(text, "\n</div>\n");
+    same(whole(flags), fromfile(flags), "unclosed");
+
+    /* a pipe can't be read twice, so the definitions have to come
+     * before they're used
+     */
+    say("pipe ");
+    build(20000, 0, 1);
+    same(whole(flags), frompipe(flags), "pipe");
+
+    say("header ");
+    strcpy(text, "% title\n% author\n% date\n\nbody\n");
+    if ( (f = tmpfile()) == 0 )
+	fail("tmpfile");
+    fputs(text, f);
+    rewind(f);
+    if ( (doc = mkd_stream_in(f, flags)) == 0 || !mkd_compile(doc, flags) )
+	fail("header");
+    if ( strcmp(mkd_doc_title(doc), "title") || strcmp(mkd_doc_date(doc), "date")
+		    || mkd_document(doc, &html) < 0 || strcmp(html, "<p>body</p>") )
+	fail("header");
+    mkd_cleanup(doc);
+    fclose(f);
+
+    mkd_free_flags(flags);
+    say("ok\n");
+    exit(0);
+}
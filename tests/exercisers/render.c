@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+char *sample = "# header\n"
+	       "\n"
+	       "a [link](/here) and a footnote[^note] & a table:\n"
+	       "\n"
+	       "| a | b |\n"
+	       "|---|:-:|\n"
+	       "| c | d |\n"
+	       "\n"
+	       "[^note]: the note\n";
+
+
+char *
+absolute(const char *url, const int size, void *base)
+{
+    char *ret = malloc(strlen(base) + size + 1);
+
+    sprintf(ret, "%s%.*s", (char*)base, size, url);
+    return ret;
+}
+
+
+void
+release(char *url, int size, void *data)
+{
+    free(url);
+}
+
+
+int
+main(void)
+{
+    mkd_flag_t *flags = mkd_flags();
+    mkd_flag_t *cdata = mkd_flags();
+    MMIOT *doc;
+    char *html, *first, *second;
+    int size;
+    struct mkd_render_options email;
+
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+    mkd_set_flag_num(cdata, MKD_CDATA);
+
+    say("check rendering: ");
+
+    if ( (doc = mkd_string(sample, strlen(sample), flags)) == 0 )
+	fail("mkd_string");
+    if ( !mkd_compile(doc, flags) )
+	fail("mkd_compile");
+
+    say("default ");
+    if ( (size = mkd_render_html(doc, 0, &first)) <= 0 )
+	fail("mkd_render_html");
+
+    say("again ");
+    if ( mkd_render_html(doc, 0, &second) != size || strcmp(first, second) )
+	fail("second rendering");
+    free(second);
+
+    say("options ");
+    memset(&email, 0, sizeof email);
+    email.ref_prefix = "mail";
+    email.e_url.func = absolute;
+    email.e_url.free = release;
+    email.e_url.data = "http://example.com";
+    if ( mkd_render_html(doc, &email, &second) <= 0 )
+	fail("mkd_render_html(options)");
+    if ( !strstr(second, "href=\"http://example.com/here\"")
+			|| !strstr(second, "mail:") )
+	fail("options");
+    free(second);
+
+    say("cdata ");
+    email.flags = cdata;
+    email.e_url.func = 0;
+    if ( mkd_render_html(doc, &email, &second) <= 0 || !strstr(second, "&lt;h1") )
+	fail("cdata");
+    free(second);
+
+    say("document ");
+    if ( mkd_document(doc, &html) != size || strcmp(html, first) )
+	fail("mkd_document");
+    free(first);
+
+    mkd_cleanup(doc);
+    mkd_free_flags(flags);
+    mkd_free_flags(cdata);
+
+    say("ok\n");
+    exit(0);
+}
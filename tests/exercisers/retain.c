@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+char *sample = "<div>trusted</div>\n"
+	       "\n"
+	       "| a | b |\n"
+	       "|---|---|\n"
+	       "| c | d |\n"
+	       "\n"
+	       "~~~\n"
+	       "code\n"
+	       "~~~\n";
+
+
+/* compile a fresh copy of sample with flags, for comparison */
+char *
+fresh(mkd_flag_t *flags)
+{
+    MMIOT *doc = mkd_string(sample, strlen(sample), flags);
+    char *html, *ret;
+
+    if ( !doc || !mkd_compile(doc, flags) || mkd_document(doc, &html) < 0 )
+	fail("fresh document");
+    ret = strdup(html);
+    mkd_cleanup(doc);
+    return ret;
+}
+
+
+void
+check(MMIOT *doc, mkd_flag_t *flags, char *what)
+{
+    char *html, *want = fresh(flags);
+
+    say(what);
+    say(" ");
+    if ( !mkd_compile(doc, flags) || mkd_document(doc, &html) < 0 )
+	fail("compile");
+    if ( strcmp(html, want) != 0 )
+	fail(what);
+    free(want);
+}
+
+
+int
+main(void)
+{
+    mkd_flag_t *trusted = mkd_flags();
+    mkd_flag_t *untrusted = mkd_flags();
+    MMIOT *doc;
+
+    mkd_set_flag_num(trusted, MKD_FENCEDCODE);
+    mkd_set_flag_num(untrusted, MKD_NOHTML);
+    mkd_set_flag_num(untrusted, MKD_NOTABLES);
+
+    say("check recompiling: ");
+
+    if ( (doc = mkd_string(sample, strlen(sample), trusted)) == 0 )
+	fail("mkd_string");
+    if ( mkd_retain_source(doc) != 0 )
+	fail("mkd_retain_source");
+
+    check(doc, trusted, "trusted");
+    check(doc, untrusted, "untrusted");
+    check(doc, trusted, "trusted");
+
+    say("compiled ");
+    if ( mkd_retain_source(doc) != EOF )
+	fail("retain after compile");
+
+    mkd_cleanup(doc);
+    mkd_free_flags(trusted);
+    mkd_free_flags(untrusted);
+
+    say("ok\n");
+    exit(0);
+}
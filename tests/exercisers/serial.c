@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+char *sample = "% title\n"
+	       "% author\n"
+	       "% date\n"
+	       "# header\n"
+	       "\n"
+	       "some *text* with [a link][1] and a footnote[^note]\n"
+	       "\n"
+	       "* one\n"
+	       "* [x] two\n"
+	       "\n"
+	       "> %quote%\n"
+	       "> quoted ~~text~~\n"
+	       "\n"
+	       "```c\n"
+	       "int x;\n"
+	       "```\n"
+	       "\n"
+	       "| a | b |\n"
+	       "|---|:-:|\n"
+	       "| c | d |\n"
+	       "\n"
+	       "[1]: http://example.com \"title\"\n"
+	       "[^note]: the note\n";
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+int
+main(void)
+{
+    mkd_flag_t *flags = mkd_flags();
+    MMIOT *doc, *copy, *bad;
+    char *buf, *html, *html2, *saved;
+    int size, szhtml, i, j;
+    static unsigned char bytes[] = { 0, 1, 2, 0x10, 0x7e, 0x7f, 0x80, 0xff };
+
+    mkd_set_flag_num(flags, MKD_FENCEDCODE);
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+    mkd_set_flag_num(flags, MKD_TOC);
+
+    say("check serialization: ");
+
+    say("compile ");
+    if ( (doc = mkd_string(sample, strlen(sample), flags)) == 0 )
+	fail("mkd_string");
+    if ( !mkd_compile(doc, flags) )
+	fail("mkd_compile");
+
+    say("serialize ");
+    if ( (size = mkd_serialize(doc, &buf)) <= 0 )
+	fail("mkd_serialize");
+    if ( (saved = malloc(size)) == 0 )
+	fail("malloc");
+    memcpy(saved, buf, size);
+
+    say("deserialize ");
+    if ( (copy = mkd_deserialize(saved, size)) == 0 )
+	fail("mkd_deserialize");
+
+    say("generate ");
+    szhtml = mkd_document(doc, &html);
+    if ( mkd_document(copy, &html2) != szhtml || memcmp(html, html2, szhtml) != 0 )
+	fail("html");
+    if ( strcmp(mkd_doc_title(copy), "title") != 0 )
+	fail("title");
+
+    /* a document that's been damaged in transit is either refused
+     * or can still be turned into html
+     */
+    say("mangled ");
+    for ( i=4; i < size; i++ ) {
+	for ( j=0; j < sizeof bytes; j++ ) {
+	    char *mangled = malloc(size);
+
+	    memcpy(mangled, saved, size);
+	    mangled[i] = bytes[j];
+	    if ( (bad = mkd_deserialize(mangled, size)) ) {
+		mkd_document(bad, &html2);
+		mkd_cleanup(bad);
+	    }
+	    free(mangled);
+	}
+    }
+
+    say("truncated ");
+    for ( ; size > 0; --size )
+	if ( mkd_deserialize(saved, size-1) )
+	    fail("truncated buffer");
+
+    say("garbage ");
+    if ( mkd_deserialize("DMKS\001\377\377\377\377\377\377\377\377\377\377\377", 16) )
+	fail("garbage");
+
+    mkd_cleanup(copy);
+    mkd_cleanup(doc);
+    free(saved);
+    mkd_free_flags(flags);
+
+    say("ok\n");
+    exit(0);
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+char *sample = "# A header\n"
+	       "\n"
+	       "A paragraph with a [link][one] and a footnote[^1].\n"
+	       "\n"
+	       "<div>\n"
+	       "html & stuff\n"
+	       "</div>\n"
+	       "\n"
+	       "* a list\n"
+	       "* with \"quotes\" in it\n"
+	       "\n"
+	       "~~~\n"
+	       "code <b>\n"
+	       "~~~\n"
+	       "\n"
+	       "The last paragraph.\n"
+	       "\n"
+	       "[one]: http://one\n"
+	       "[^1]: the footnote\n";
+
+
+/* a sink that only takes a few bytes at a time (and, after a while,
+ * fails or stops taking anything)
+ */
+struct sink {
+    char out[20000];
+    int size;
+    int calls;
+    int fail;
+    int stall;
+} sink;
+
+int
+drip(const char *text, int size, void *ctx)
+{
+    struct sink *s = ctx;
+
+    s->calls++;
+    if ( s->fail && s->calls >= s->fail )
+	return EOF;
+    if ( s->stall && s->calls >= s->stall )
+	return 0;
+    if ( size > 5 )
+	size = 5;
+    memcpy(s->out + s->size, text, size);
+    s->size += size;
+    return size;
+}
+
+
+/* what mkd_generatehtml() writes */
+char *
+expected(MMIOT *doc, mkd_flag_t *flags)
+{
+    static char html[20000];
+    char *text, *xml;
+    int size;
+
+    if ( (size = mkd_document(doc, &text)) < 0 )
+	fail("mkd_document");
+    if ( mkd_flag_isset(flags, MKD_CDATA) ) {
+	size = mkd_xml(text, size, &xml);
+	memcpy(html, xml, size);
+	free(xml);
+    }
+    else
+	memcpy(html, text, size);
+    html[size++] = '\n';
+    html[size] = 0;
+    return html;
+}
+
+
+void
+check(mkd_flag_t *flags, char *what)
+{
+    MMIOT *doc;
+    char *want;
+
+    say(what);
+    say(" ");
+
+    /* streamed before the html has been generated */
+    if ( (doc = mkd_string(sample, strlen(sample), flags)) == 0 || !mkd_compile(doc, flags) )
+	fail(what);
+    memset(&sink, 0, sizeof sink);
+    if ( mkd_generate_to(doc, drip, &sink) != 0 )
+	fail(what);
+    want = expected(doc, flags);
+    if ( (sink.size != strlen(want)) || memcmp(sink.out, want, sink.size) )
+	fail(what);
+
+    /* and streamed again after it's been generated */
+    memset(&sink, 0, sizeof sink);
+    if ( mkd_generate_to(doc, drip, &sink) != 0 )
+	fail(what);
+    if ( (sink.size != strlen(want)) || memcmp(sink.out, want, sink.size) )
+	fail(what);
+    mkd_cleanup(doc);
+}
+
+
+int
+main()
+{
+    MMIOT *doc;
+    mkd_flag_t *flags = mkd_flags();
+
+    say("check streaming: ");
+
+    check(flags, "html");
+    mkd_set_flag_num(flags, MKD_FENCEDCODE);
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+    check(flags, "footnotes");
+    mkd_set_flag_num(flags, MKD_CDATA);
+    check(flags, "cdata");
+
+    say("errors ");
+    if ( (doc = mkd_string(sample, strlen(sample), flags)) == 0 || !mkd_compile(doc, flags) )
+	fail("errors");
+    memset(&sink, 0, sizeof sink);
+    sink.fail = 10;
+    if ( mkd_generate_to(doc, drip, &sink) != EOF || sink.calls != 10 )
+	fail("errors");
+    memset(&sink, 0, sizeof sink);
+    sink.stall = 10;
+    if ( mkd_generate_to(doc, drip, &sink) != EOF || sink.calls != 10 )
+	fail("stalled");
+    mkd_cleanup(doc);
+
+    mkd_free_flags(flags);
+    say("ok\n");
+    exit(0);
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+/* bits of markdown to glue together into documents
+ */
+char *bits[] = { "\n", "\n\n", "~~~\n", "<div>\n", "</div>\n", "<style>\n", "</style>\n",
+		 "[one]: http://one\n", "[^1]: a footnote\n", "# hdr\n", "* item\n",
+		 "1. item\n", "> quote\n", "    indented\n", "text ", "|a|b|\n|-|-|\n",
+		 "[one][] ", "[^1] ", "^sup ", "*em* ", "**strong", "`code` ", "<b>",
+		 "-----\n", "term\n:   definition\n" };
+#define NRBITS	(sizeof bits / sizeof bits[0])
+
+static unsigned long state = 1;
+
+static int
+rnd(int n)
+{
+    state = state * 1103515245 + 12345;
+    return (int)((state >> 16) % n);
+}
+
+
+char text[40000];
+
+char *
+html(int threads, mkd_flag_t *flags)
+{
+    MMIOT *doc = mkd_string(text, strlen(text), flags);
+    char *res, *ret;
+
+    if ( !doc )
+	fail("mkd_string");
+    if ( threads )
+	mkd_threads(doc, threads);
+    if ( !mkd_compile(doc, flags) || mkd_document(doc, &res) < 0 )
+	fail("compile");
+    ret = strdup(res);
+    mkd_cleanup(doc);
+    return ret;
+}
+
+
+void
+compare(mkd_flag_t *flags, int count, char *what)
+{
+    char *serial, *parallel;
+    int i, size;
+
+    say(what);
+    say(" ");
+    for ( i=0; i < count; i++ ) {
+	text[0] = 0;
+	for ( size = rnd(1000); size > 0; --size )
+	    strcat(text, bits[rnd(NRBITS)]);
+
+	serial = html(0, flags);
+	parallel = html(4, flags);
+	if ( strcmp(serial, parallel) != 0 ) {
+	    fprintf(stderr, "text:\n%s\nserial:\n%s\nparallel:\n%s\n", text, serial, parallel);
+	    fail(what);
+	}
+	free(serial);
+	free(parallel);
+    }
+}
+
+
+int
+main()
+{
+    mkd_flag_t *flags = mkd_flags();
+
+    say("check threads: ");
+
+    if ( mkd_threads(0, 4) != EOF )
+	fail("null document");
+
+    mkd_set_flag_num(flags, MKD_FENCEDCODE);
+    compare(flags, 200, "markdown");
+
+    mkd_set_flag_num(flags, MKD_TOC);
+    mkd_set_flag_num(flags, MKD_HTML5);
+    compare(flags, 200, "toc");
+
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+    compare(flags, 200, "footnotes");
+
+    mkd_free_flags(flags);
+    say("ok\n");
+    exit(0);
+}
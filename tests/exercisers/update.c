@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <string.h>
+#include <mkdio.h>
+#include <stdlib.h>
+
+void
+say(char *what)
+{
+    fputs(what,stdout);
+    fflush(stdout);
+}
+
+
+void
+fail(char *why)
+{
+    say(why);
+    say(" FAILED\n");
+    exit(1);
+}
+
+
+char *sample = "% title\n"
+	       "% author\n"
+	       "% date\n"
+	       "# A header\n"
+	       "\n"
+	       "Some text with a [link][one] and a footnote[^1].\n"
+	       "\n"
+	       "<div>\n"
+	       "html\n"
+	       "</div>\n"
+	       "\n"
+	       "* a list\n"
+	       "* with [another][two] link\n"
+	       "\n"
+	       "~~~\n"
+	       "code\n"
+	       "~~~\n"
+	       "\n"
+	       "# A header\n"
+	       "\n"
+	       "[one]: http://one \"one\"\n"
+	       "[two]: http://two\n"
+	       "[^1]: the footnote\n"
+	       "\n"
+	       "    code block\n"
+	       "\n"
+	       "last paragraph\n";
+
+/* the text the document should have in it now */
+char text[20000];
+
+
+/* compile a fresh copy of text with flags, for comparison */
+char *
+fresh(mkd_flag_t *flags)
+{
+    MMIOT *doc = mkd_string(text, strlen(text), flags);
+    char *html, *ret;
+
+    if ( !doc || !mkd_compile(doc, flags) || mkd_document(doc, &html) < 0 )
+	fail("fresh document");
+    ret = strdup(html);
+    mkd_cleanup(doc);
+    return ret;
+}
+
+
+void
+edit(MMIOT *doc, mkd_flag_t *flags, int offset, int removed, char *insert, char *what)
+{
+    char *html, *want;
+    int size = strlen(text);
+
+    if ( mkd_update(doc, offset, removed, insert) != 0 )
+	fail(what);
+
+    memmove(text+offset+strlen(insert), text+offset+removed, size-(offset+removed)+1);
+    memcpy(text+offset, insert, strlen(insert));
+
+    want = fresh(flags);
+    if ( !mkd_compile(doc, flags) || mkd_document(doc, &html) < 0 )
+	fail(what);
+    if ( strcmp(html, want) != 0 ) {
+	fprintf(stderr, "text:\n%s\ngot:\n%s\nwanted:\n%s\n", text, html, want);
+	fail(what);
+    }
+    free(want);
+}
+
+
+char *
+at(char *what)
+{
+    char *p = strstr(text, what);
+
+    if ( !p )
+	fail(what);
+    return p;
+}
+
+#define EDIT(doc,flags,where,removed,insert,what) \
+	edit(doc, flags, at(where)-text, removed, insert, what)
+
+
+/* splice random bits of markdown in random places */
+char *bits[] = { "\n", "\n\n", "~~~\n", "```\n", "<div>\n", "</div>\n",
+		 "[one]: http://changed\n", "[^1]: new note\n", "# hdr\n",
+		 "* item\n", "> quote\n", "    indented\n", "text ", "|a|b|\n|-|-|\n",
+		 "[one][]", "[^1]", "%", "", "\t", "<style>\n", "</style>\n" };
+#define NRBITS	(sizeof bits / sizeof bits[0])
+
+static unsigned long state = 1;
+
+static int
+rnd(int n)
+{
+    state = state * 1103515245 + 12345;
+    return (int)((state >> 16) % n);
+}
+
+
+void
+fuzz(mkd_flag_t *flags, int count)
+{
+    MMIOT *doc;
+    int i, size, offset, removed;
+    char *html;
+
+    strcpy(text, sample);
+    if ( (doc = mkd_edit_string(text, strlen(text), flags)) == 0 )
+	fail("mkd_edit_string");
+    if ( !mkd_compile(doc, flags) || mkd_document(doc, &html) < 0 )
+	fail("compile");
+
+    for ( i=0; i < count; i++ ) {
+	size = strlen(text);
+	offset = rnd(size+1);
+	removed = rnd(4) ? 0 : rnd(size - offset + 1) % 40;
+	if ( size > 8000 )
+	    removed = size - offset;
+	edit(doc, flags, offset, removed, bits[rnd(NRBITS)], "fuzz");
+    }
+    mkd_cleanup(doc);
+}
+
+
+int
+main()
+{
+    MMIOT *doc;
+    mkd_flag_t *flags = mkd_flags();
+    char *html;
+
+    say("check updates: ");
+
+    mkd_set_flag_num(flags, MKD_FENCEDCODE);
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+    mkd_set_flag_num(flags, MKD_TOC);
+
+    strcpy(text, sample);
+    if ( (doc = mkd_edit_string(text, strlen(text), flags)) == 0 )
+	fail("mkd_edit_string");
+    if ( mkd_update(doc, 10000, 0, "x") != EOF )
+	fail("range");
+    if ( !mkd_compile(doc, flags) || mkd_document(doc, &html) < 0 )
+	fail("compile");
+
+    say("text ");
+    EDIT(doc, flags, "Some text", 4, "More", "text");
+    EDIT(doc, flags, "last paragraph", 0, "new ", "text");
+    EDIT(doc, flags, "last paragraph", 0, "\n\n", "text");
+
+    say("references ");
+    EDIT(doc, flags, "http://one", 10, "http://uno", "reference");
+    EDIT(doc, flags, "[two]: http://two\n", 18, "", "reference");
+    EDIT(doc, flags, "last paragraph", 0, "[two]: http://dos\n", "reference");
+    EDIT(doc, flags, "the footnote", 3, "a", "footnote");
+
+    say("blocks ");
+    EDIT(doc, flags, "* a list", 0, "~~~\n", "fence");
+    EDIT(doc, flags, "~~~\n* a list", 4, "", "fence");
+    EDIT(doc, flags, "<div>", 5, "<p>", "html");
+    EDIT(doc, flags, "<p>", 3, "<div>", "html");
+    EDIT(doc, flags, "</div>", 6, "", "html");
+    EDIT(doc, flags, "* a list", 0, "</div>\n", "html");
+
+    say("headers ");
+    EDIT(doc, flags, "# A header\n\n[one]", 10, "# Another header", "toc");
+    EDIT(doc, flags, "% author", 1, "", "pandoc");
+    EDIT(doc, flags, "title", 0, "%", "pandoc");
+
+    mkd_cleanup(doc);
+
+    say("fuzz ");
+    fuzz(flags, 2000);
+    mkd_clr_flag_num(flags, MKD_TOC);
+    mkd_set_flag_num(flags, MKD_NOHEADER);
+    fuzz(flags, 1000);
+
+    mkd_free_flags(flags);
+    say("ok\n");
+    exit(0);
+}
@@ -0,0 +1,80 @@
+. tests/functions.sh
+
+title "markdown daemon"
+
+rc=0
+MARKDOWN_FLAGS=
+
+SOCK=serve.$$.sock
+rm -f $SOCK
+
+# refused -- see if a markdown command fails like it should
+refused() {
+    try_header "$1"
+    shift
+
+    if ./markdown "$@" </dev/null >/dev/null 2>&1; then
+	__failed=`expr $__failed + 1`
+	if [ -z "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "markdown $* didn't fail"
+	rc=1
+    else
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    fi
+}
+
+./markdown -serve $SOCK -j 2 &
+daemon=$!
+
+for x in 1 2 3 4 5 6 7 8 9 10; do
+    test -S $SOCK && break
+    sleep 1
+done
+
+try "-client $SOCK" 'simple document' \
+'*hello*' \
+'<p><em>hello</em></p>'
+
+try "-client $SOCK" -ffootnote -Czz 'flags and footnote prefix' \
+'a[^1]
+
+[^1]: b' \
+'<p>a<sup id="zzref:1"><a href="#zz:1" rel="footnote">1</a></sup></p>
+<div class="footnotes">
+<hr/>
+<ol>
+<li id="zz:1">
+b<a href="#zzref:1" rev="footnote">&#8617;</a></li>
+</ol>
+</div>'
+
+try "-client $SOCK" 'flags are per request' \
+'a[^1]
+
+[^1]: b' \
+'<p>a<a href="b">^1</a></p>'
+
+try "-client $SOCK" -5 'html5 is passed along' \
+'<aside>a</aside>' \
+'<aside>a</aside>'
+
+refused '-client with -T' -client $SOCK -T
+refused '-client with -G' -client $SOCK -G
+refused '-client with -F' -client $SOCK -F 0x4
+
+refused 'a socket that is already served' -serve $SOCK
+
+try "-client $SOCK" 'and the first daemon still has it' \
+'*hello*' \
+'<p><em>hello</em></p>'
+
+kill $daemon
+wait $daemon 2>/dev/null
+rm -f $SOCK
+
+summary $0
+exit $rc
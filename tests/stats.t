@@ -0,0 +1,48 @@
+. tests/functions.sh
+
+title "document statistics"
+
+rc=0
+MARKDOWN_FLAGS=
+
+SRC='# header
+
+some *text* and _more_ text[^1]
+
+[^1]: a footnote
+
+* one
+* two
+
+> quoted'
+
+# counted -- check that a line of the statistics for $2 is $3
+counted() {
+    try_header "$1"
+
+    S=`./echo "$2" | ./markdown -stats -f footnote 2>&1 >/dev/null | grep "^$3"`
+
+    if [ "$3" = "$S" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "wanted: $3"
+	./echo "got:    $S"
+	rc=1
+    fi
+}
+
+counted 'lines' "$SRC" 'lines 10'
+counted 'paragraphs' "$SRC" \
+	'paragraphs 4 headers 1 code 0 quotes 1 lists 1 items 2 html 0 tables 0 rules 0'
+counted 'footnote lookups' "$SRC" 'footnote lookups 1'
+counted 'emphasis tokens' "$SRC" 'emphasis tokens 4'
+counted 'bytes of html' "$SRC" 'bytes out 329'
+
+summary $0
+exit $rc
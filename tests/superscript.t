@@ -16,6 +16,11 @@ try 'A^B w/ A in link' '[A](C)^B' '<p><a href="C">A</a><sup>B</sup></p>'
 try 'A^B w/ A in html' '<em>A</em>^B' '<p><em>A</em><sup>B</sup></p>'
 try 'A^B w/ ^B in link' 'A[^B](C)' '<p>A<a href="C">^B</a></p>'
 try 'A^B w/ ^B in incomplete link' 'A[^B]' '<p>A[^B]</p>'
+try '^B at the start of a paragraph' 'A
+
+^B' '<p>A</p>
+
+<p>^B</p>'
 
 summary $0
 exit $rc
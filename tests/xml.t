@@ -14,5 +14,9 @@ try -fcdata 'xml output with multibyte utf-8' \
     'tecnología y servicios más confiables' \
     '&lt;p&gt;tecnología y servicios más confiables&lt;/p&gt;'
 
+try -fcdata 'xml output with a long run of plain text' \
+    'a line of text that is long enough to need more than one pass before the <b>tag</b>' \
+    '&lt;p&gt;a line of text that is long enough to need more than one pass before the &lt;b&gt;tag&lt;/b&gt;&lt;/p&gt;'
+
 summary $0
 exit $rc
@@ -34,6 +34,7 @@
 #include "cstring.h"
 #include "amalloc.h"
 #include "gethopt.h"
+#include "buildcache.h"
 
 char *pgm = "theme";
 char *m4_file = 0;
@@ -41,6 +42,9 @@ char *output_file = 0;
 char *pagename = 0;
 char *root = 0;
 int   everywhere = 0;	/* expand all <?theme elements everywhere */
+int   cache = 0;	/* only remake pages that have changed */
+bc_hash basekey;	/* hash of everything that's the same for every page */
+int   usesfileinfo = 0;	/* the template uses the date or owner of the source */
 
 #if HAVE_PWD_H
 struct passwd *me = 0;
@@ -134,6 +138,22 @@ fail(char *why, ...)
 }
 
 
+/* complain about a page that can't be made, but carry on with the
+ * rest of them
+ */
+void
+complain(char *why, ...)
+{
+    va_list ptr;
+
+    va_start(ptr,why);
+    fprintf(stderr, "%s: ", pgm);
+    vfprintf(stderr, why, ptr);
+    fputc('\n', stderr);
+    va_end(ptr);
+}
+
+
 /* open_template() -- start at the current directory and work up,
  *                    looking for the deepest nested template. 
  *                    Stop looking when we reach $root or /
@@ -276,36 +296,6 @@ prepare_flags(mkd_flag_t *flags, int where)
 }
 
 
-/* finclude() includes some (unformatted) source
- */
-static void
-finclude(MMIOT *doc, FILE *out, mkd_flag_t *flags, int whence)
-{
-    int c;
-    Cstring include;
-    FILE *f;
-
-    CREATE(include);
-
-    while ( (c = pull()) != '(' )
-	;
-
-    while ( (c=pull()) != ')' && c != EOF )
-	EXPAND(include) = c;
-
-    if ( c != EOF ) {
-	COMPLETE(include);
-
-	if (( f = fopen(T(include), "r") )) {
-	    while ( (c = getc(f)) != EOF )
-		putc(c, out);
-	    fclose(f);
-	}
-    }
-    DELETE(include);
-}
-
-
 /* fdirname() prints out the directory part of a path
  */
 static void
@@ -456,7 +446,7 @@ static struct _keyword {
     { "toc?>",     INBODY, ftoc },
     { "date?>",    0xffff, fdate },
     { "dir?>",     0xffff, fdirname },
-    { "include(",  0xffff, finclude },
+    { "include(",  0xffff, 0 },	/* done when the template is compiled */
     { "source?>",  0xffff, fbasename },
     { "style?>",   INHEAD, fstyle },
     { "title?>",   0xffff, ftitle },
@@ -468,10 +458,101 @@ static struct _keyword {
 
 
 
-/* spin() - run through the theme template, looking for <?theme expansions
+/* a compiled template is a list of literal text, each piece followed
+ * by the theme expansion (if any) that comes after it.   Whether an
+ * expansion is done at all depends only on where it is in the template,
+ * so that's all worked out when the template is compiled.
  */
-void
-spin(FILE *template, MMIOT *doc, mkd_flag_t *flags, FILE *output)
+typedef struct {
+    Cstring text;	/* literal text */
+    int action;		/* then this keyword[] expansion (or -1 for none) */
+    int where;		/* INTAG, INHEAD, INBODY at the expansion */
+} Op;
+
+typedef STRING(Op) Template;
+
+
+/* add some literal text to the template
+ */
+static void
+literal(Template *tmpl, char *text, int size)
+{
+    Op *op = &T(*tmpl)[S(*tmpl)-1];
+
+    SUFFIX(op->text, text, size);
+}
+
+
+static void
+literalc(Template *tmpl, int c)
+{
+    EXPAND(T(*tmpl)[S(*tmpl)-1].text) = c;
+}
+
+
+/* start a new piece of literal text
+ */
+static void
+newop(Template *tmpl)
+{
+    Op *op = &EXPAND(*tmpl);
+
+    CREATE(op->text);
+    op->action = -1;
+    op->where = 0;
+}
+
+
+/* end the current piece of literal text with an expansion
+ */
+static void
+expansion(Template *tmpl, int action, int where)
+{
+    Op *op = &T(*tmpl)[S(*tmpl)-1];
+
+    op->action = action;
+    op->where = where;
+    newop(tmpl);
+}
+
+
+/* include some (unformatted) source into the template
+ */
+static void
+finclude(Template *tmpl)
+{
+    int c;
+    Cstring include;
+    char buf[1024];
+    int size;
+    FILE *f;
+
+    CREATE(include);
+
+    while ( (c = pull()) != '(' && c != EOF )
+	;
+
+    while ( (c=pull()) != ')' && c != EOF )
+	EXPAND(include) = c;
+
+    if ( c != EOF ) {
+	COMPLETE(include);
+
+	if (( f = fopen(T(include), "r") )) {
+	    while ( (size = fread(buf, 1, sizeof buf, f)) > 0 )
+		literal(tmpl, buf, size);
+	    fclose(f);
+	}
+    }
+    DELETE(include);
+}
+
+
+/* compile() - run through the theme template, looking for <?theme
+ *             expansions
+ */
+static void
+compile(FILE *template, Template *tmpl)
 {
     int c;
     int *p;
@@ -480,14 +561,19 @@ spin(FILE *template, MMIOT *doc, mkd_flag_t *flags, FILE *output)
 
     prepare(template);
 
+    CREATE(*tmpl);
+    newop(tmpl);
+
     while ( (c = pull()) != EOF ) {
 	if ( c == '<' ) {
 	    if ( peek(1) == '!' && peek(2) == '-' && peek(3) == '-' ) {
-		fputs("<!--", output);
+		literal(tmpl, "<!--", 4);
 		shift(3);
-		do {
-		    putc(c=pull(), output);
-		} while ( ! (c == '-' && peek(1) == '-' && peek(2) == '>') );
+		while ( (c = pull()) != EOF ) {
+		    literalc(tmpl, c);
+		    if ( c == '-' && peek(1) == '-' && peek(2) == '>' )
+			break;
+		}
 	    }
 	    else if ( (peek(1) == '?') && thesame(cursor(), "?theme ") ) {
 		shift(strlen("?theme "));
@@ -501,8 +587,10 @@ spin(FILE *template, MMIOT *doc, mkd_flag_t *flags, FILE *output)
 		for (i=0; i < NR(keyword); i++)
 		    if ( thesame(p, keyword[i].kw) ) {
 			if ( everywhere || (keyword[i].where & where) ) {
-			    prepare_flags(flags,where);
-			    (*keyword[i].what)(doc,output,flags,where);
+			    if ( keyword[i].what )
+				expansion(tmpl, i, where);
+			    else
+				finclude(tmpl);
 			}
 			break;
 		    }
@@ -512,7 +600,7 @@ spin(FILE *template, MMIOT *doc, mkd_flag_t *flags, FILE *output)
 		shift(1);
 	    }
 	    else
-		putc(c, output);
+		literalc(tmpl, c);
 
 	    if ( istag(cursor(), "head") ) {
 		where |= INHEAD;
@@ -528,12 +616,260 @@ spin(FILE *template, MMIOT *doc, mkd_flag_t *flags, FILE *output)
 	else if ( c == '>' )
 	    where &= ~INTAG;
 
-	putc(c, output);
+	literalc(tmpl, c);
+    }
+    DELETE(inbuf);
+} /* compile */
+
+
+/* spin() - write a page from a compiled template
+ */
+static void
+spin(Template *tmpl, MMIOT *doc, mkd_flag_t *flags, FILE *output)
+{
+    int i;
+    Op *op;
+
+    for ( i=0; i < S(*tmpl); i++ ) {
+	op = &T(*tmpl)[i];
+
+	if ( S(op->text) )
+	    fwrite(T(op->text), S(op->text), 1, output);
+
+	if ( op->action >= 0 ) {
+	    prepare_flags(flags, op->where);
+	    (*keyword[op->action].what)(doc, output, flags, op->where);
+	}
     }
 } /* spin */
 
 
+/* tmplkey() -- hash everything that goes into every page
+ */
+static bc_hash
+tmplkey(Template *tmpl, mkd_flag_t *flags)
+{
+    bc_hash key = bc_string(BC_START, markdown_version, strlen(markdown_version));
+    int i;
+    Op *op;
+
+    key = bc_flags(key, flags);
+    key = bc_string(key, everywhere ? "E" : "-", 1);
+
+    if ( m4_file ) {
+	key = bc_string(key, m4_file, 1+strlen(m4_file));
+	key = bc_file(key, m4_file);
+    }
+
+    if ( tmpl ) {
+	/* include()d files are already in the compiled template */
+	for ( i=0; i < S(*tmpl); i++ ) {
+	    op = &T(*tmpl)[i];
+	    key = bc_string(key, T(op->text), S(op->text));
+	    key = bc_string(key, (char*)&op->action, sizeof op->action);
+	    key = bc_string(key, (char*)&op->where, sizeof op->where);
+
+	    if ( (op->action >= 0) && (keyword[op->action].what == fdate
+				    || keyword[op->action].what == fauthor) )
+		usesfileinfo = 1;
+	}
+    }
+    else
+	key = bc_string(key, "", 1);
+
+    return key;
+}
+
+
+/* pagefile() -- work out the source and html file names for a page
+ *               (or complain and return 0 if there isn't a source)
+ */
+static char *
+pagefile(char *arg, char **output)
+{
+    char *source;
+    struct stat sourceinfo;
+    char *p, *q;
+
+    if ( (source = malloc(strlen(arg) + strlen("/index.text") + 1)) == 0 )
+	fail("out of memory allocating name buffer");
+
+    strcpy(source,arg);
+    if ( (stat(source, &sourceinfo) == 0) && S_ISDIR(sourceinfo.st_mode) )
+	strcat(source, "/index");
+
+    if ( access(source, R_OK) != 0 ) {
+	strcat(source, ".text");
+	if ( access(source, R_OK) != 0 ) {
+	    complain("can't open either %s or %s", arg, source);
+	    free(source);
+	    return 0;
+	}
+    }
+
+    if ( !*output ) {
+	if ( (*output = malloc(strlen(source) + strlen(".html") + 1)) == 0 )
+	    fail("out of memory allocating output file name buffer");
+
+	strcpy(*output, source);
+
+	if (( p = strchr(*output, '/') ))
+	    q = strrchr(p+1, '.');
+	else
+	    q = strrchr(*output, '.');
+
+	if ( q )
+	    *q = 0;
+	else
+	    q = *output + strlen(*output);
+
+	strcat(q, ".html");
+    }
+    return source;
+}
+
+
+/* giveup() -- stop making a page that can't be finished
+ */
+static int
+giveup(FILE *output, MMIOT *doc)
+{
+    if ( doc )
+	mkd_cleanup(doc);
+    if ( output != stdout )
+	fclose(output);
+    return 1;
+}
+
+
+/* page() -- make a web page out of source (or stdin), returning 0 if
+ *           it was made (or didn't need to be) and 1 if it failed.
+ */
+static int
+page(char *source, char *output_file, char *title, int force,
+					  Template *tmpl, mkd_flag_t *flags)
+{
+    FILE *input, *output = stdout;
+    MMIOT *doc;
+    mkd_flag_t *spinflags;
+    struct stat sourceinfo;
+    static char obuf[BUFSIZ*16];
+    static char *home = 0;
+    bc_hash key;
+    int caching = 0;
+
+    if ( source && !freopen(source, "r", stdin) ) {
+	complain("can't open %s", source);
+	return 1;
+    }
+
+    pagename = title ? title : (source ? source : "stdin");
+
+    if ( cache && source && output_file && strcmp(output_file, "-")
+					 && notspecial(output_file) ) {
+	key = bc_string(basekey, pagename, 1+strlen(pagename));
+	key = bc_file(key, source);
+
+	if ( usesfileinfo && (fstat(fileno(stdin), &sourceinfo) == 0) ) {
+	    key = bc_string(key, (char*)&sourceinfo.st_mtime, sizeof sourceinfo.st_mtime);
+	    key = bc_string(key, (char*)&sourceinfo.st_uid, sizeof sourceinfo.st_uid);
+	}
+
+	if ( !force && bc_fresh(output_file, key) )
+	    return 0;
+	caching = 1;
+    }
+
+    if ( output_file && strcmp(output_file, "-") ) {
+	if ( force && notspecial(output_file) )
+	    unlink(output_file);
+	if ( (output = fopen(output_file, "w")) == 0 ) {
+	    complain("can't write to %s", output_file);
+	    return 1;
+	}
+	setvbuf(output, obuf, _IOFBF, sizeof obuf);
+    }
+
+    if ( m4_file ) {
+	char *m4_command_line;
+	int len=0;
+
+	len = 8; /* length of 'm4 "',  '" -' & '\0' */
+
+	if ( (m4_command_line = malloc(len + strlen(m4_file))) == NULL )
+	    fail("can't allocate temporary storage?");
+
+	sprintf(m4_command_line, "m4 \"%s\" -", m4_file);
+
+	input = popen(m4_command_line, "r");
+	free(m4_command_line);
+	if ( input == NULL ) {
+	    complain("can't run m4 preprocessor (%s)", strerror(errno));
+	    return giveup(output, 0);
+	}
+    }
+    else
+	input = stdin;
+
+    doc = mkd_in(input, 0);
+
+    if ( input != stdin )
+	pclose(input);
+
+    if ( doc == 0 ) {
+	complain("can't read %s", source ? source : "stdin");
+	return giveup(output, 0);
+    }
+
+    infop = 0;
+    if ( fstat(fileno(stdin), &sourceinfo) == 0 )
+	infop = &sourceinfo;
+
+#if HAVE_GETPWUID
+    if ( !me || (me->pw_uid != (infop ? infop->st_uid : getuid())) ) {
+	me = getpwuid(infop ? infop->st_uid : getuid());
+
+	if ( home )
+	    free(home);
+	if ( (root = home = strdup(me->pw_dir)) == 0 )
+	    fail("out of memory");
+    }
+#endif
+
+    if ( !mkd_compile(doc, flags) ) {
+	complain("couldn't compile %s", source ? source : "input");
+	return giveup(output, doc);
+    }
+
+    if ( tmpl ) {
+	/* expansions change the flags, so don't let them leak into
+	 * the next page
+	 */
+	if ( (spinflags = mkd_copy_flags(flags)) == 0 )
+	    fail("out of memory");
+	spin(tmpl, doc, spinflags, output);
+	mkd_free_flags(spinflags);
+    }
+    else
+	mkd_generatehtml(doc, output);
+
+    mkd_cleanup(doc);
+
+    if ( (output == stdout) ? (fflush(output) == EOF) : (fclose(output) == EOF) ) {
+	complain("can't write to %s", output_file ? output_file : "stdout");
+	return 1;
+    }
+
+    if ( caching )
+	bc_record(output_file, key);
+    return 0;
+}
+
+
+enum { CACHE=1 };
+
 struct h_opt opts[] = {
+    { CACHE, "cache", 0, 0, "only remake pages that have changed" },
     { 0, 0, 'c', "flags",  "set/show rendering options" },
     { 0, 0, 'C', "bitmap", "set/show rendering options numerically" },
     { 0, 0, 'd', "dir",    "set the document root" },
@@ -551,14 +887,15 @@ int
 main(int argc, char **argv)
 {
     char *template = "page.theme";
-    char *source = "stdin";
+    char *source;
+    char *output;
     FILE *tmplfile;
-    FILE *input;
+    Template tmpl;
     int force = 0;
-    MMIOT *doc;
-    struct stat sourceinfo;
+    int i, failed = 0;
     char *q;
     char *env;
+    char *title = 0;
     int show_version = 0; /* 0: run the program, 1: show version #, 2: show version# and initial flags */
 
     struct h_opt *opt;
@@ -593,7 +930,7 @@ main(int argc, char **argv)
 
     while ( opt = gethopt(&blob, opts, NROPTS) ) {
 	if ( opt == HOPTERR ) {
-	    hoptusage(pgm, opts, NROPTS, "[file]");
+	    hoptusage(pgm, opts, NROPTS, "[file...]");
 	    exit(1);
 	}
 	switch ( opt->optchar ) {
@@ -603,7 +940,7 @@ main(int argc, char **argv)
 		    break;
 	case 'm':   m4_file = hoptarg(&blob);
 		    break;
-	case 'p':   pagename = hoptarg(&blob);
+	case 'p':   title = hoptarg(&blob);
 		    break;
 	case 'f':   force = 1;
 		    break;
@@ -620,6 +957,9 @@ main(int argc, char **argv)
 		    break;
 	case 'V':   show_version++;
 		    break;
+	case 0:	    if ( opt->option == CACHE )
+			cache = 1;
+		    break;
 	}
     }
 
@@ -635,102 +975,48 @@ main(int argc, char **argv)
     if ( env = getenv("THEME_OPTIONS") )
 	mkd_set_flag_string(flags, env);
 
-    tmplfile = open_template(template);
+    /* the template is compiled once and used for every page
+     */
+    if ( tmplfile = open_template(template) )
+	compile(tmplfile, &tmpl);
 
     argc -= hoptind(&blob);
     argv += hoptind(&blob);
 
+    if ( output_file && (argc > 1) )
+	fail("can't use -o with more than one file");
 
-    if ( argc > 0 ) {
-	int added_text=0;
+    if ( cache )
+	basekey = tmplkey(tmplfile ? &tmpl : 0, flags);
 
-	if ( (source = malloc(strlen(argv[0]) + strlen("/index.text") + 1)) == 0 )
-	    fail("out of memory allocating name buffer");
-
-	strcpy(source,argv[0]);
-	if ( (stat(source, &sourceinfo) == 0) && S_ISDIR(sourceinfo.st_mode) )
-	    strcat(source, "/index");
-
-	if ( !freopen(source, "r", stdin) ) {
-	    strcat(source, ".text");
-	    added_text = 1;
-	    if ( !freopen(source, "r", stdin) )
-		fail("can't open either %s or %s", argv[0], source);
-	}
-
-	if ( !output_file ) {
-	    char *p, *q;
-
-
-	    if ( (output_file = malloc(strlen(source) + strlen(".html") + 1)) == 0 )
-		fail("out of memory allocating output file name buffer");
-
-	    strcpy(output_file, source);
-
-	    if (( p = strchr(output_file, '/') ))
-		q = strrchr(p+1, '.');
-	    else
-		q = strrchr(output_file, '.');
-
-	    if ( q )
-		*q = 0;
-	    else
-		q = output_file + strlen(output_file);
-
-	    strcat(q, ".html");
-	}
-    }
-    if ( output_file && strcmp(output_file, "-") ) {
-	if ( force && notspecial(output_file) )
-	    unlink(output_file);
-	if ( !freopen(output_file, "w", stdout) ) {
-	    fail("can't write to %s", output_file);
+    if ( argc > 0 ) {
+	for ( i=0; i < argc; i++ ) {
+	    output = output_file;
+	    if ( (source = pagefile(argv[i], &output)) == 0 ) {
+		failed++;
+		continue;
+	    }
+	    failed += page(source, output, title, force, tmplfile ? &tmpl : 0, flags);
+	    if ( output != output_file )
+		free(output);
+	    free(source);
 	}
-    }
-
-    if ( !pagename )
-	pagename = source;
-
-    if ( m4_file ) {
-	char *m4_command_line;
-	int len=0;
-
-	len = 8; /* length of 'm4 "',  '" -' & '\0' */
-
-	if ( (m4_command_line = malloc(len + strlen(m4_file))) == NULL )
-	    fail("can't allocate temporary storage?");
-
-	sprintf(m4_command_line, "m4 \"%s\" -", m4_file);
-
-	if ( (input = popen(m4_command_line, "r")) == NULL )
-	    fail("can't run m4 preprocessor (%s)", strerror(errno));
+	if ( failed )
+	    complain("%d of %d page%s failed", failed, argc, (argc == 1) ? "" : "s");
     }
     else
-	input = stdin;
-
-    if ( (doc = mkd_in(input, 0)) == 0 )
-	fail("can't read %s", source ? source : "stdin");
-
-    if ( fstat(fileno(stdin), &sourceinfo) == 0 )
-	infop = &sourceinfo;
-
-#if HAVE_GETPWUID
-    me = getpwuid(infop ? infop->st_uid : getuid());
+	failed = page(0, output_file, title, force, tmplfile ? &tmpl : 0, flags);
 
-    if ( (root = strdup(me->pw_dir)) == 0 )
-	fail("out of memory");
-#endif
-
-    if ( !mkd_compile(doc, flags) )
-	fail("couldn't compile input");
-
-    if ( tmplfile )
-	spin(tmplfile, doc, flags, stdout);
-    else
-	mkd_generatehtml(doc, stdout);
+    if ( cache && (bc_save() == EOF) ) {
+	complain("can't write the build cache");
+	failed++;
+    }
 
-    mkd_cleanup(doc);
+    if ( tmplfile ) {
+	for ( i=0; i < S(tmpl); i++ )
+	    DELETE(T(tmpl)[i].text);
+	DELETE(tmpl);
+    }
     mkd_free_flags(flags);
-    exit(0);
+    exit(failed ? 1 : 0);
 }
-
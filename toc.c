@@ -30,6 +30,8 @@ mkd_toc(Document *p, char **doc)
     Cstring res;
     int size;
     int first = 1;
+    double start;
+    struct acounts *charged;
 #if HAVE_NAMED_INITIALIZERS
     static mkd_flag_t islabel = { { [IS_LABEL] = 1 } };
 #else
@@ -46,6 +48,8 @@ mkd_toc(Document *p, char **doc)
 
     if ( ! is_flag_set(&p->ctx->flags, MKD_TOC) ) return 0;
 
+    start = STAT_START(p);
+    charged = ACHARGE(p, A_GENERATE);
     CREATE(res);
     RESERVE(res, 100);
 
@@ -101,75 +105,175 @@ mkd_toc(Document *p, char **doc)
 	*doc = strdup(T(res));
     }
     DELETE(res);
+    STAT_TIME(p, toc, start);
+    acharge(charged);
     return size;
 }
 
 
 /*
- * rewrite *name so it doesn't collide with any of the header labels
- * in this document.
+ * the labels that have been handed out, in a hash table so finding
+ * out if one is already taken doesn't mean looking at all of them.
  */
-static void
-decollide(Paragraph *current, Cstring *name, int suffix)
+static unsigned int
+labelhash(char *name)
 {
-    Paragraph *content;
-    int needed, alloc;
-    int seq = 0;
-    char *sufp;
-
-    /* first decollide all the children
-     */
-    for ( content = current; content; content = content->next ) {
-	if ( content->down )
-	    decollide(content->down, name, suffix);
-    }
+    unsigned int h = 0;
 
-restart:
-    for ( content = current; content; content = content->next ) {
-	if ( content->typ == HDR && content->text && content->label ) {
-	    if ( strcmp(T(*name), content->label) == 0 ) {
-		/* collision; bump trailing sequence and try again
-		  */
-		alloc = ALLOCATED(*name)-suffix;
-		sufp = T(*name) + suffix;
-		needed = 1+snprintf(sufp, alloc, "_%d", seq);
-		if ( needed > alloc ) {
-		    RESERVE(*name, needed);
-		    snprintf(sufp, needed, "_%d", seq);
-		}
-		++seq;
-		goto restart;
+    while ( *name )
+	h = (h * 31) + (unsigned char)*name++;
+    return h;
+}
+
+
+/* is name already in the table?
+ */
+static struct label *
+findlabel(Labels *set, char *name)
+{
+    struct label *p;
+
+    if ( set->nrbuckets == 0 )
+	return 0;
+
+    for ( p = set->bucket[labelhash(name) % set->nrbuckets]; p; p = p->chain )
+	if ( strcmp(p->name, name) == 0 )
+	    return p;
+    return 0;
+}
+
+
+/* put name into the table, making the table bigger if it's getting
+ * crowded
+ */
+static struct label *
+addlabel(Labels *set, char *name)
+{
+    struct label *p, *next, **bucket;
+    int i, size;
+    unsigned int h;
+
+    if ( set->count >= set->nrbuckets ) {
+	size = set->nrbuckets ? (set->nrbuckets * 2) : 64;
+	if ( (bucket = calloc(size, sizeof bucket[0])) == 0 )
+	    return 0;
+	for ( i=0; i < set->nrbuckets; i++ )
+	    for ( p = set->bucket[i]; p; p = next ) {
+		next = p->chain;
+		h = labelhash(p->name) % size;
+		p->chain = bucket[h];
+		bucket[h] = p;
 	    }
-	}
+	if ( set->bucket )
+	    free(set->bucket);
+	set->bucket = bucket;
+	set->nrbuckets = size;
     }
-    return;
+
+    if ( (p = malloc(sizeof *p)) == 0 )
+	return 0;
+    if ( (p->name = strdup(name)) == 0 ) {
+	free(p);
+	return 0;
+    }
+    p->next = 0;
+    h = labelhash(name) % set->nrbuckets;
+    p->chain = set->bucket[h];
+    set->bucket[h] = p;
+    set->count++;
+    return p;
+}
+
+
+/* start (or start over with) an empty table
+ */
+void
+___mkd_initlabels(Labels *set)
+{
+    set->bucket = 0;
+    set->nrbuckets = 0;
+    set->count = 0;
+}
+
+
+/* throw away all the labels in a table
+ */
+void
+___mkd_freelabels(Labels *set)
+{
+    struct label *p, *next;
+    int i;
+
+    for ( i=0; i < set->nrbuckets; i++ )
+	for ( p = set->bucket[i]; p; p = next ) {
+	    next = p->chain;
+	    free(p->name);
+	    free(p);
+	}
+    if ( set->bucket )
+	free(set->bucket);
+    ___mkd_initlabels(set);
 }
 
 
 /*
- * set up to run decollide on *name
+ * return (a malloc()ed copy of) base, or base_0, base_1, ... if it's
+ * already taken, and add it to the table.  The base remembers which
+ * suffix to try next, so a page with thousands of headers that say
+ * the same thing doesn't try all the earlier suffixes again for each
+ * one.
  */
-static char *
-uniquename(ParagraphRoot *pr, Cstring *name)
+char *
+___mkd_uniquelabel(Labels *set, char *base)
 {
-    Cstring label;
-    int suffix;
-    char *final;
+    struct label *p;
+    char *name;
 
-    suffix = S(*name);
+    if ( (p = findlabel(set, base)) == 0 ) {
+	addlabel(set, base);
+	return strdup(base);
+    }
+
+    if ( (name = malloc(strlen(base) + 20)) == 0 )
+	return 0;
+    do
+	sprintf(name, "%s_%d", base, p->next++);
+    while ( findlabel(set, name) );
 
-    CREATE(label);
-    RESERVE(label, suffix + 200);
+    addlabel(set, name);
+    return name;
+}
 
-    strcpy(T(label), T(*name));
-    S(label) = S(*name);
 
-    decollide(T(*pr), &label, suffix);
+/*
+ * put the labels that are already in the document into the table
+ */
+static void
+oldlabels(Labels *set, Paragraph *pp)
+{
+    for ( ; pp; pp = pp->next ) {
+	if ( pp->down )
+	    oldlabels(set, pp->down);
+	if ( pp->typ == HDR && pp->text && pp->label
+			    && !findlabel(set, pp->label) )
+	    addlabel(set, pp->label);
+    }
+}
 
-    final = strdup(T(label));
-    DELETE(label);
 
-    return final;
+/*
+ * give the unlabeled headers at this level (and in the sources under
+ * it) their labels
+ */
+static void
+uniquify(Labels *set, Paragraph *pp)
+{
+    for ( ; pp; pp = pp->next ) {
+	if ( pp->typ == SOURCE )
+	    uniquify(set, pp->down);
+	else if ( pp->typ == HDR && T(pp->text->text) && !pp->label )
+	    pp->label = ___mkd_uniquelabel(set, T(pp->text->text));
+    }
 }
 
 
@@ -180,26 +284,15 @@ uniquename(ParagraphRoot *pr, Cstring *name)
 void
 ___mkd_uniquify(ParagraphRoot *pr, Paragraph *pp)
 {
-    Paragraph *content;
-
+    Labels set;
 
     if ( !(pr && pp) )
 	return;
 
-    /* unique all the headers at this level */
-    for (content = pp; content; content = content->next) {
-	if ( content->typ == SOURCE )
-	    ___mkd_uniquify(pr, content->down);
-	else if ( content->typ == HDR && T(content->text->text) )
-	    content->label = uniquename(pr, &(content->text->text));
-    }
-
-#if 0
-    /* unique all the children */
-    for (content = pp; content; content = content->next)
-	if ( content->down )
-	    ___mkd_uniquify(pr, content->down);
-#endif
+    ___mkd_initlabels(&set);
+    oldlabels(&set, T(*pr));
+    uniquify(&set, pp);
+    ___mkd_freelabels(&set);
 }
 
 
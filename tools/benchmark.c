@@ -0,0 +1,175 @@
+/*
+ * benchmark: time how long discount takes to read (mkd_string),
+ *            compile (mkd_compile), and generate html (mkd_document)
+ *            for some documents.
+ *
+ * usage: benchmark [-f flags] [-t seconds] file...
+ *
+ * Each document is converted over and over until at least `seconds`
+ * (default 1) have gone by, and the fastest time for each phase is
+ * reported as MB/s and ns/byte.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "mkdio.h"
+
+#define MINRUNS	3
+
+static double
+now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + (tv.tv_usec / 1e6);
+}
+
+
+static char *
+slurp(char *file, long *size)
+{
+    FILE *f;
+    char *text = 0;
+    long alloc = 0;
+    int len;
+
+    *size = 0;
+    if ( (f = fopen(file, "r")) == 0 )
+	return 0;
+
+    while ( 1 ) {
+	if ( *size + 8192 > alloc ) {
+	    alloc = alloc ? 2*alloc : 65536;
+	    if ( (text = realloc(text, alloc)) == 0 ) {
+		fclose(f);
+		return 0;
+	    }
+	}
+	if ( (len = fread(text + *size, 1, 8192, f)) <= 0 )
+	    break;
+	*size += len;
+    }
+
+    fclose(f);
+    return text;
+}
+
+
+static void
+report(char *phase, double secs, long size)
+{
+    if ( secs <= 0 )
+	printf("  %-8s       --- MB/s        --- ns/byte\n", phase);
+    else
+	printf("  %-8s %9.2f MB/s %10.2f ns/byte\n", phase,
+		    (size / (1024.0*1024.0)) / secs, (secs * 1e9) / size);
+}
+
+
+static struct phase {
+    char *name;
+    double best;
+} phases[] = { { "ingest" }, { "compile" }, { "generate" }, { "total" } };
+#define NRPHASES	(sizeof phases / sizeof phases[0])
+
+
+/* run one document through discount until enough time has gone by
+ */
+static int
+bench(char *file, mkd_flag_t *flags, double duration)
+{
+    char *text, *html;
+    long size;
+    MMIOT *doc;
+    double t[4], start;
+    int i, runs;
+
+    if ( (text = slurp(file, &size)) == 0 ) {
+	perror(file);
+	return 1;
+    }
+    if ( size == 0 ) {
+	fprintf(stderr, "%s: empty file\n", file);
+	free(text);
+	return 1;
+    }
+
+    for ( i=0; i < NRPHASES; i++ )
+	phases[i].best = -1;
+
+    start = now();
+    for ( runs=0; (runs < MINRUNS) || (now() - start < duration); runs++ ) {
+	t[0] = now();
+	if ( (doc = mkd_string(text, size, flags)) == 0 ) {
+	    fprintf(stderr, "%s: mkd_string failed\n", file);
+	    free(text);
+	    return 1;
+	}
+	t[1] = now();
+	if ( !mkd_compile(doc, flags) ) {
+	    fprintf(stderr, "%s: mkd_compile failed\n", file);
+	    mkd_cleanup(doc);
+	    free(text);
+	    return 1;
+	}
+	t[2] = now();
+	mkd_document(doc, &html);
+	t[3] = now();
+	mkd_cleanup(doc);
+
+	for ( i=0; i < 3; i++ )
+	    if ( (phases[i].best < 0) || (t[i+1]-t[i] < phases[i].best) )
+		phases[i].best = t[i+1]-t[i];
+	if ( (phases[3].best < 0) || (t[3]-t[0] < phases[3].best) )
+	    phases[3].best = t[3]-t[0];
+    }
+
+    printf("%s: %ld bytes, %d runs\n", file, size, runs);
+    for ( i=0; i < NRPHASES; i++ )
+	report(phases[i].name, phases[i].best, size);
+
+    free(text);
+    return 0;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    int opt, i, rc = 0;
+    double duration = 1.0;
+    char *q;
+    mkd_flag_t *flags = mkd_flags();
+
+    if ( !flags ) {
+	perror("mkd_flags");
+	exit(1);
+    }
+    mkd_set_flag_num(flags, MKD_FENCEDCODE);
+    mkd_set_flag_num(flags, MKD_EXTRA_FOOTNOTE);
+
+    while ( (opt = getopt(argc, argv, "f:t:")) != EOF ) {
+	switch (opt) {
+	case 'f':   if ( q = mkd_set_flag_string(flags, optarg) ) {
+			fprintf(stderr, "%s: unknown flag <%s>\n", argv[0], q);
+			exit(1);
+		    }
+		    break;
+	case 't':   duration = atof(optarg);
+		    break;
+	default:    fprintf(stderr, "usage: %s [-f flags] [-t seconds] file...\n", argv[0]);
+		    exit(1);
+	}
+    }
+
+    for ( i=optind; i < argc; i++ )
+	rc |= bench(argv[i], flags, duration);
+
+    mkd_free_flags(flags);
+    exit(rc);
+}
@@ -0,0 +1,359 @@
+/*
+ * corpus: generate a (deterministic) markdown document of a given
+ *         size for benchmarking.
+ *
+ * usage: corpus [-s seed] [-k kind,kind...] [-o file] size
+ *
+ * The document is made out of sections of prose, lists, nested
+ * quotes, tables, reference links, fenced code, html blocks, and
+ * footnotes (or just the kinds given with -k), chosen by a simple
+ * random number generator so that the same seed and size always
+ * produce the same document.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+
+static unsigned long state = 1;
+
+/* xorshift; we want the same corpus everywhere, so don't use random()
+ */
+static unsigned long
+rnd(unsigned long n)
+{
+    state ^= (state << 13) & 0xffffffffUL;
+    state ^= state >> 17;
+    state ^= (state << 5) & 0xffffffffUL;
+    return n ? (state % n) : 0;
+}
+
+static char *words[] = {
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+    "markdown", "discount", "paragraph", "header", "list", "item",
+    "table", "code", "block", "quote", "link", "image", "footnote",
+    "a", "an", "of", "to", "in", "is", "was", "for", "on", "with",
+    "document", "compiler", "generate", "html", "text", "reference",
+    "émigré", "naïve", "über", "Ørsted",
+};
+#define NRWORDS	(sizeof words / sizeof words[0])
+
+static long written = 0;
+static FILE *out;
+static int refs = 0;		/* reference links waiting for definitions */
+static int notes = 0;		/* footnotes waiting for definitions */
+
+static void
+put(char *s)
+{
+    written += strlen(s);
+    fputs(s, out);
+}
+
+static void
+putf(char *fmt, int n)
+{
+    written += fprintf(out, fmt, n);
+}
+
+static void
+indent(int n)
+{
+    while ( n-- > 0 )
+	put(" ");
+}
+
+static char *
+word(void)
+{
+    return words[rnd(NRWORDS)];
+}
+
+
+/* a line of text with some inline markup
+ */
+static void
+sentence(int inline_markup)
+{
+    int i, count = 5 + rnd(12);
+
+    for ( i=0; i < count; i++ ) {
+	if ( i )
+	    put(" ");
+	if ( inline_markup ) {
+	    switch ( rnd(24) ) {
+	    case 0: put("*"); put(word()); put("*"); continue;
+	    case 1: put("**"); put(word()); put(" "); put(word()); put("**"); continue;
+	    case 2: put("`"); put(word()); put("()`"); continue;
+	    case 3: put("["); put(word()); put("](http://example.com/");
+		    put(word()); put(")"); continue;
+	    case 4: put("_"); put(word()); put("_"); continue;
+	    case 5: put("<http://example.com/"); put(word()); put(">"); continue;
+	    case 6: put("&amp; "); break;
+	    }
+	}
+	put(word());
+    }
+}
+
+
+static void
+prose(void)
+{
+    int i, lines = 1 + rnd(6);
+
+    if ( rnd(4) == 0 ) {
+	put(rnd(2) ? "## " : "### ");
+	sentence(0);
+	put("\n\n");
+    }
+    for ( i=0; i < lines; i++ ) {
+	sentence(1);
+	put(".\n");
+    }
+    put("\n");
+}
+
+
+static void
+list(int depth)
+{
+    int i, items = 2 + rnd(5);
+    int ordered = rnd(2);
+
+    for ( i=0; i < items; i++ ) {
+	indent(depth*4);
+	if ( ordered )
+	    putf("%d. ", i+1);
+	else
+	    put("* ");
+	sentence(1);
+	put("\n");
+	if ( (depth < 3) && (rnd(4) == 0) ) {
+	    put("\n");
+	    list(depth+1);
+	}
+    }
+    put("\n");
+}
+
+
+static void
+quote(void)
+{
+    int i, j, depth = 1 + rnd(4);
+    int lines = 1 + rnd(4);
+
+    for ( i=0; i < lines; i++ ) {
+	for ( j=0; j < depth; j++ )
+	    put("> ");
+	sentence(1);
+	put("\n");
+    }
+    put("\n");
+}
+
+
+static void
+table(void)
+{
+    int i, j, cols = 2 + rnd(4), rows = 2 + rnd(8);
+
+    for ( j=0; j < cols; j++ ) {
+	put("| ");
+	put(word());
+	put(" ");
+    }
+    put("|\n");
+    for ( j=0; j < cols; j++ )
+	put( (j & 1) ? "|:---:" : "|-----" );
+    put("|\n");
+    for ( i=0; i < rows; i++ ) {
+	for ( j=0; j < cols; j++ ) {
+	    put("| ");
+	    put(word());
+	    put(" ");
+	    if ( rnd(3) == 0 ) put("*x*");
+	}
+	put("|\n");
+    }
+    put("\n");
+}
+
+
+static void
+reflinks(void)
+{
+    int i, count = 1 + rnd(4);
+
+    for ( i=0; i < count; i++ ) {
+	sentence(0);
+	put(" [");
+	put(word());
+	putf("][%d] ", refs++);
+    }
+    put("\n\n");
+}
+
+
+static void
+fenced(void)
+{
+    int i, lines = 1 + rnd(12);
+    char *fence = rnd(2) ? "```" : "~~~";
+
+    put(fence);
+    put(rnd(2) ? "c\n" : "\n");
+    for ( i=0; i < lines; i++ ) {
+	indent(4*rnd(3));
+	put(word());
+	put("(a < b && c > d); /* ");
+	put(word());
+	put(" */\n");
+    }
+    put(fence);
+    put("\n\n");
+}
+
+
+static void
+lists(void)
+{
+    list(0);
+}
+
+
+static void
+htmlblock(void)
+{
+    put("<div class=\"");
+    put(word());
+    put("\">\n<p>");
+    sentence(0);
+    put("</p>\n</div>\n\n");
+}
+
+
+static void
+footnotes(void)
+{
+    sentence(1);
+    putf("[^n%d] ", notes++);
+    sentence(0);
+    put(".\n\n");
+}
+
+
+static struct kind {
+    char *name;
+    void (*make)(void);
+    int weight;
+    int on;
+} kinds[] = {
+    { "prose",     prose,     8, 1 },
+    { "lists",     lists,     3, 1 },
+    { "quotes",    quote,     2, 1 },
+    { "tables",    table,     1, 1 },
+    { "refs",      reflinks,  2, 1 },
+    { "code",      fenced,    2, 1 },
+    { "html",      htmlblock, 1, 1 },
+    { "footnotes", footnotes, 1, 1 },
+};
+#define NRKINDS	(sizeof kinds / sizeof kinds[0])
+
+
+static void
+usage(char *pgm)
+{
+    int i;
+
+    fprintf(stderr, "usage: %s [-s seed] [-k kind,kind...] [-o file] size\n", pgm);
+    fprintf(stderr, "kinds:");
+    for ( i=0; i < NRKINDS; i++ )
+	fprintf(stderr, " %s", kinds[i].name);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    long size;
+    int opt, i, total;
+    char *p;
+    unsigned long pick;
+
+    out = stdout;
+
+    while ( (opt = getopt(argc, argv, "s:k:o:")) != EOF ) {
+	switch (opt) {
+	case 's':   state = strtoul(optarg, 0, 0);
+		    if ( state == 0 )
+			state = 1;
+		    break;
+	case 'k':   for ( i=0; i < NRKINDS; i++ )
+			kinds[i].on = 0;
+		    for ( p = strtok(optarg, ","); p; p = strtok(0, ",") ) {
+			for ( i=0; i < NRKINDS; i++ )
+			    if ( strcmp(p, kinds[i].name) == 0 ) {
+				kinds[i].on = 1;
+				break;
+			    }
+			if ( i == NRKINDS )
+			    usage(argv[0]);
+		    }
+		    break;
+	case 'o':   if ( (out = fopen(optarg, "w")) == 0 ) {
+			perror(optarg);
+			exit(1);
+		    }
+		    break;
+	default:    usage(argv[0]);
+	}
+    }
+
+    if ( optind != argc-1 || (size = strtol(argv[optind], &p, 0)) <= 0 )
+	usage(argv[0]);
+    switch (*p) {
+    case 'k': case 'K': size *= 1024; break;
+    case 'm': case 'M': size *= 1024*1024; break;
+    }
+
+    for ( total=i=0; i < NRKINDS; i++ )
+	if ( kinds[i].on )
+	    total += kinds[i].weight;
+
+    while ( written < size ) {
+	pick = rnd(total);
+	for ( i=0; i < NRKINDS; i++ )
+	    if ( kinds[i].on ) {
+		if ( pick < kinds[i].weight ) {
+		    (*kinds[i].make)();
+		    break;
+		}
+		pick -= kinds[i].weight;
+	    }
+    }
+
+    /* and the definitions for all the references */
+    for ( i=0; i < refs; i++ ) {
+	putf("[%d]: http://example.com/ref/", i);
+	putf("%d \"a title\"\n", i);
+    }
+    if ( refs )
+	put("\n");
+    for ( i=0; i < notes; i++ ) {
+	putf("[^n%d]: ", i);
+	sentence(1);
+	put("\n\n");
+    }
+
+    if ( fclose(out) == EOF ) {
+	perror("corpus");
+	exit(1);
+    }
+    exit(0);
+}
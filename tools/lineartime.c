@@ -0,0 +1,421 @@
+/*
+ * lineartime: make sure that pathological inputs take (close to)
+ *             linear time.
+ *
+ * usage: lineartime [-v] [-t tolerance] [family...]
+ *
+ * Each family of adversarial documents is generated at sizes n, 2n,
+ * 4n and 8n (with n picked so the smallest one takes long enough to
+ * time) and rendered with mkd_string, mkd_compile, and mkd_document
+ * (and mkd_toc, if the family is compiled with MKD_TOC).
+ * If the time for 8n is more than 8*tolerance (default 2.5) times the
+ * time for n, that family is reported as superlinear and lineartime
+ * exits with a failure status.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "mkdio.h"
+
+#define MINTIME	0.004	/* smallest size must take at least this long */
+#define RUNS	3	/* best of this many runs */
+
+typedef struct {
+    char *text;
+    long size, alloc;
+} Buf;
+
+static void
+add(Buf *b, char *s, long len)
+{
+    if ( b->size + len + 1 > b->alloc ) {
+	b->alloc = 2 * (b->size + len + 1);
+	if ( (b->text = realloc(b->text, b->alloc)) == 0 ) {
+	    perror("lineartime");
+	    exit(1);
+	}
+    }
+    memcpy(b->text + b->size, s, len);
+    b->size += len;
+    b->text[b->size] = 0;
+}
+
+static void
+adds(Buf *b, char *s)
+{
+    add(b, s, strlen(s));
+}
+
+static void
+addn(Buf *b, int c, long count)
+{
+    char ch = c;
+
+    while ( count-- > 0 )
+	add(b, &ch, 1);
+}
+
+static void
+addf(Buf *b, char *fmt, long n)
+{
+    char tmp[80];
+
+    sprintf(tmp, fmt, n);
+    adds(b, tmp);
+}
+
+
+/* the families of pathological documents
+ */
+static void
+unclosed_brackets(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ )
+	adds(b, "[a ");
+}
+
+static void
+nested_brackets(Buf *b, long n)
+{
+    addn(b, '[', n);
+    adds(b, "a\n");
+}
+
+static void
+escaped_brackets(Buf *b, long n)
+{
+    long i;
+
+    /* escaped brackets that parenthetical() can still start after */
+    for ( i=0; i < n; i++ )
+	adds(b, "\\[a ![b ");
+    adds(b, "]\n");
+}
+
+static void
+superscripts(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ )
+	adds(b, "a^(b ");
+}
+
+static void
+backtick_runs(Buf *b, long n)
+{
+    long i;
+
+    /* runs of backticks that never find a closing run of the
+     * same length
+     */
+    for ( i=0; i < n; i++ ) {
+	addn(b, '`', 1 + (i % 16));
+	adds(b, " a ");
+	if ( i % 64 == 63 )
+	    adds(b, "\n");
+    }
+}
+
+static void
+tick_ladder(Buf *b, long n)
+{
+    long len;
+
+    /* runs that get longer and longer, so none of them ever close */
+    for ( len=1; b->size < n; len++ ) {
+	addn(b, '`', len);
+	adds(b, " a ");
+    }
+    adds(b, "\n");
+}
+
+static void
+tick_run(Buf *b, long n)
+{
+    adds(b, "a ");
+    addn(b, '`', n);
+    adds(b, "\n");
+}
+
+static void
+nested_quotes(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ ) {
+	addn(b, '>', 1 + (i % 32));
+	adds(b, " a\n");
+    }
+}
+
+static void
+emphasis(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ )
+	adds(b, (i & 1) ? "*a _" : "_b **");
+}
+
+static void
+unterminated_fences(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ ) {
+	addn(b, (i & 1) ? '`' : '~', 3 + (i % 8));
+	adds(b, "c\ncode\n\n");
+    }
+}
+
+static void
+duplicate_headers(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ )
+	adds(b, "# header\n\n");
+}
+
+static void
+footnotes(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ )
+	addf(b, "a[^%ld]\n", i);
+    adds(b, "\n");
+    for ( i=0; i < n; i++ )
+	addf(b, "[^%ld]: note\n\n", i);
+}
+
+static void
+deep_lists(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ ) {
+	addn(b, ' ', 4 * (i % 16));
+	adds(b, "* item\n");
+    }
+}
+
+static void
+unclosed_links(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ )
+	adds(b, "[a](b ");
+}
+
+static void
+autolinks(Buf *b, long n)
+{
+    long i;
+
+    /* one enormous word that's almost a url */
+    adds(b, "http://");
+    for ( i=0; i < n; i++ )
+	adds(b, "a.b:c");
+    adds(b, "\n");
+}
+
+static void
+long_token(Buf *b, long n)
+{
+    long i;
+
+    /* a base64 blob that isn't a link at all */
+    for ( i=0; i < n; i++ )
+	adds(b, (i & 1) ? "Zm9v" : "YmFy");
+    adds(b, "\n");
+}
+
+static void
+dotted_token(Buf *b, long n)
+{
+    long i;
+
+    /* one enormous word made of words that could each start a link */
+    for ( i=0; i < n; i++ )
+	adds(b, "a.b:c");
+    adds(b, "\n");
+}
+
+static void
+open_tags(Buf *b, long n)
+{
+    long i;
+
+    for ( i=0; i < n; i++ )
+	adds(b, "<a b ");
+}
+
+static void
+templates(Buf *b, long n)
+{
+    long i;
+
+    /* c++ templates and shell redirections, with one tag at the very
+     * end for all of them to look for
+     */
+    for ( i=0; i < n; i++ )
+	adds(b, (i & 1) ? "vector<vector<int>> v; " : "cmd <in 2>&1 ");
+    adds(b, "<b>\n");
+}
+
+
+static struct family {
+    char *name;
+    void (*make)(Buf *, long);
+    long n;		/* starting size */
+    long max;		/* don't go bigger than this */
+    int flags[4];	/* flags to set (0-terminated, so no MKD_NOLINKS) */
+} family[] = {
+    { "unclosed-brackets",   unclosed_brackets,   100, 1L<<20 },
+    { "unclosed-links",      unclosed_links,      100, 1L<<20 },
+    { "nested-brackets",     nested_brackets,     100, 1L<<20 },
+    { "escaped-brackets",    escaped_brackets,    100, 1L<<20 },
+    { "superscripts",        superscripts,        100, 1L<<20 },
+    { "backtick-runs",       backtick_runs,       100, 1L<<20 },
+    { "tick-ladder",         tick_ladder,         100, 1L<<22 },
+    { "tick-run",            tick_run,            100, 1L<<20 },
+    { "nested-quotes",       nested_quotes,       100, 1L<<20 },
+    { "emphasis",            emphasis,            100, 1L<<20 },
+    { "unterminated-fences", unterminated_fences, 100, 1L<<20, { MKD_FENCEDCODE } },
+    { "duplicate-headers",   duplicate_headers,   100, 1L<<20, { MKD_TOC } },
+    { "footnotes",           footnotes,           100, 1L<<20, { MKD_EXTRA_FOOTNOTE } },
+    { "deep-lists",          deep_lists,          100, 1L<<20 },
+    { "autolink",            autolinks,           100, 1L<<20, { MKD_AUTOLINK } },
+    { "long-token",          long_token,       1L<<15, 1L<<20, { MKD_AUTOLINK } },
+    { "dotted-token",        dotted_token,        100, 1L<<20, { MKD_AUTOLINK } },
+    { "open-tags",           open_tags,           100, 1L<<20 },
+    { "templates",           templates,           100, 1L<<20 },
+};
+#define NRFAMILY	(sizeof family / sizeof family[0])
+
+
+static double
+now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + (tv.tv_usec / 1e6);
+}
+
+
+/* how long (best of RUNS) it takes to render a family at size n
+ */
+static double
+timeit(struct family *f, long n, mkd_flag_t *flags)
+{
+    Buf b = { 0, 0, 0 };
+    double best = -1, start, t;
+    MMIOT *doc;
+    char *html, *toc;
+    int i;
+
+    (*f->make)(&b, n);
+
+    for ( i=0; i < RUNS; i++ ) {
+	start = now();
+	if ( doc = mkd_string(b.text, b.size, flags) ) {
+	    if ( mkd_compile(doc, flags) ) {
+		mkd_document(doc, &html);
+		if ( mkd_toc(doc, &toc) > 0 )
+		    free(toc);
+	    }
+	    mkd_cleanup(doc);
+	}
+	t = now() - start;
+	if ( (best < 0) || (t < best) )
+	    best = t;
+    }
+    free(b.text);
+    return best;
+}
+
+
+static int verbose = 0;
+
+static int
+check(struct family *f, double tolerance)
+{
+    mkd_flag_t *flags = mkd_flags();
+    double t[4];
+    double ratio;
+    long n;
+    int i, bad;
+
+    for ( i=0; f->flags[i]; i++ )
+	mkd_set_flag_num(flags, f->flags[i]);
+
+    /* find a size that takes long enough to measure */
+    for ( n = f->n; (n*16 <= f->max) && (timeit(f, n, flags) < MINTIME); n *= 2 )
+	;
+
+    for ( i=0; i < 4; i++ )
+	t[i] = timeit(f, n << i, flags);
+    mkd_free_flags(flags);
+
+    ratio = (t[0] > 0) ? (t[3] / t[0]) : 0;
+    bad = (ratio > 8 * tolerance);
+
+    if ( verbose || bad ) {
+	printf("%-20s n=%-8ld", f->name, n);
+	for ( i=0; i < 4; i++ )
+	    printf(" %9.4f", t[i]);
+	printf("  x%.1f", ratio);
+	if ( bad )
+	    printf("  SUPERLINEAR");
+	putchar('\n');
+    }
+    return bad;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    int opt, i, j, failed = 0;
+    double tolerance = 2.5;
+
+    while ( (opt = getopt(argc, argv, "vt:")) != EOF ) {
+	switch (opt) {
+	case 'v':   verbose = 1;
+		    break;
+	case 't':   tolerance = atof(optarg);
+		    break;
+	default:    fprintf(stderr, "usage: %s [-v] [-t tolerance] [family...]\n", argv[0]);
+		    exit(1);
+	}
+    }
+
+    if ( optind < argc ) {
+	for ( i=optind; i < argc; i++ ) {
+	    for ( j=0; j < NRFAMILY; j++ )
+		if ( strcmp(argv[i], family[j].name) == 0 ) {
+		    failed += check(&family[j], tolerance);
+		    break;
+		}
+	    if ( j == NRFAMILY ) {
+		fprintf(stderr, "%s: no family %s\n", argv[0], argv[i]);
+		failed++;
+	    }
+	}
+    }
+    else
+	for ( j=0; j < NRFAMILY; j++ )
+	    failed += check(&family[j], tolerance);
+
+    exit(failed ? 1 : 0);
+}
@@ -0,0 +1,646 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 Jessica L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "config.h"
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/*
+ * editable documents:  a document made with mkd_edit_string() keeps
+ * its text, and mkd_update() splices changes into that text, then
+ * recompiles only the top-level blocks (the html, style, fenced code,
+ * and markdown source chunks that compile_document() breaks a document
+ * into) that the change could have touched.   Recompiling starts at
+ * the last block that begins before the change and stops at the first
+ * old block after the change where compile_document() would start from
+ * scratch; everything after that is reused.
+ *
+ * Reference links and footnotes are looked up when the html is
+ * generated, not when the document is compiled, so the definitions in
+ * the recompiled region are replaced and the next mkd_document() picks
+ * them up everywhere.
+ */
+typedef int (*stfu)(const void*,const void*);
+
+extern int __mkd_footsort(Footnote *, Footnote *);
+
+
+/* which line is offset `pos` in?
+ */
+static int
+whichline(struct mkd_edit *e, int pos)
+{
+    int lo = 0, hi = S(e->line)-1, mid;
+
+    while ( lo < hi ) {
+	mid = (lo + hi + 1) / 2;
+	if ( T(e->line)[mid] <= pos )
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    return lo;
+}
+
+
+/* number the lines of a document (starting at `lineno`)
+ */
+static void
+number(Line *p, int lineno)
+{
+    for ( ; p ; p = p->next )
+	p->lineno = lineno++;
+}
+
+
+#define between(x,lo,hi)	(((x) >= (lo)) && ((x) < (hi)))
+
+
+/* make input lines for lines [from..to) of an editable document
+ */
+Line *
+___mkd_edit_lines(Document *doc, int from, int to)
+{
+    struct mkd_edit *e = doc->edit;
+    mkd_flag_t flags;
+    Document *tmp;
+    Line *ret;
+    int start, end;
+
+    if ( !e || from >= to )
+	return 0;
+
+    start = T(e->line)[from];
+    end = (to < S(e->line)) ? T(e->line)[to] : S(e->text);
+
+    /* these lines aren't at the top of the document, so they
+     * can't be a pandoc header
+     */
+    COPY_FLAGS(flags, e->flags);
+    set_mkd_flag(&flags, MKD_NOHEADER);
+
+    if ( (tmp = mkd_string(T(e->text)+start, end-start, &flags)) == 0 )
+	return 0;
+
+    ret = T(tmp->content);
+    T(tmp->content) = 0;
+    mkd_cleanup(tmp);
+
+    number(ret, from);
+    return ret;
+}
+
+
+/* read the whole text of an editable document again
+ */
+static int
+reread(Document *doc)
+{
+    struct mkd_edit *e = doc->edit;
+    Document *tmp;
+
+    if ( (tmp = mkd_string(T(e->text), S(e->text), &e->flags)) == 0 )
+	return EOF;
+
+    if ( doc->title ) ___mkd_freeLine(doc->title);
+    if ( doc->author ) ___mkd_freeLine(doc->author);
+    if ( doc->date ) ___mkd_freeLine(doc->date);
+    if ( T(doc->content) ) ___mkd_freeLines(T(doc->content));
+
+    doc->title = tmp->title;
+    doc->author = tmp->author;
+    doc->date = tmp->date;
+    doc->content = tmp->content;
+
+    tmp->title = tmp->author = tmp->date = 0;
+    memset(&tmp->content, 0, sizeof tmp->content);
+    mkd_cleanup(tmp);
+
+    e->header = doc->title ? 3 : 0;
+    number(T(doc->content), e->header);
+    return 0;
+}
+
+
+/* make a document that can be changed with mkd_update()
+ */
+Document *
+mkd_edit_string(const char *buf, int len, mkd_flag_t *flags)
+{
+    Document *doc;
+    struct mkd_edit *e;
+    int i;
+
+    if ( (doc = mkd_string(buf, len, flags)) == 0 )
+	return 0;
+
+    if ( (e = calloc(1, sizeof *e)) == 0 ) {
+	mkd_cleanup(doc);
+	return 0;
+    }
+    doc->edit = e;
+
+    CREATE(e->text);
+    if ( len > 0 )
+	SUFFIX(e->text, (char*)buf, len);
+
+    CREATE(e->line);
+    EXPAND(e->line) = 0;
+    for ( i=0; i < len; i++ )
+	if ( buf[i] == '\n' )
+	    EXPAND(e->line) = i+1;
+
+    if ( flags )
+	COPY_FLAGS(e->flags, *flags);
+    else
+	mkd_init_flags(&e->flags);
+
+    e->header = doc->title ? 3 : 0;
+    number(T(doc->content), e->header);
+
+    return doc;
+}
+
+
+/* throw away a list of footnotes
+ */
+static void
+freenotes(struct footnote_list *notes)
+{
+    int i;
+
+    for ( i=0; i < S(notes->note); i++ )
+	___mkd_freefootnote(&T(notes->note)[i]);
+    DELETE(notes->note);
+    free(notes);
+}
+
+
+static int
+bylineno(Footnote *a, Footnote *b)
+{
+    return a->lineno - b->lineno;
+}
+
+
+/* drop the footnotes that were defined in [from..to) (old line #s),
+ * renumber the ones after that, and add the new ones from the
+ * recompiled region.   Then sort them back into document order
+ * before sorting them by tag, so they end up in the same order
+ * a fresh compile would put them in.
+ */
+static void
+refile(struct footnote_list *notes, struct footnote_list *new,
+       int from, int to, int delta)
+{
+    int i, j;
+    Footnote *f;
+
+    for ( i=j=0; i < S(notes->note); i++ ) {
+	f = &T(notes->note)[i];
+
+	if ( between(f->lineno, from, to) )
+	    ___mkd_freefootnote(f);
+	else {
+	    if ( f->lineno >= to )
+		f->lineno += delta;
+	    T(notes->note)[j++] = *f;
+	}
+    }
+    S(notes->note) = j;
+
+    for ( i=0; i < S(new->note); i++ )
+	EXPAND(notes->note) = T(new->note)[i];
+    S(new->note) = 0;
+
+    qsort(T(notes->note), S(notes->note), sizeof T(notes->note)[0],
+						(stfu)bylineno);
+    qsort(T(notes->note), S(notes->note), sizeof T(notes->note)[0],
+						(stfu)__mkd_footsort);
+}
+
+
+/* forget the toc labels so ___mkd_uniquify() can hand them out again
+ */
+static void
+unlabel(Paragraph *p)
+{
+    for ( ; p ; p = p->next ) {
+	if ( p->typ == SOURCE )
+	    unlabel(p->down);
+	else if ( p->typ == HDR && p->label ) {
+	    free(p->label);
+	    p->label = 0;
+	}
+    }
+}
+
+
+/* recompile the blocks around lines [first..last] (old line #s) of
+ * a document that's had `delta` lines added to it.
+ */
+static int
+recompile(Document *doc, int first, int last, int delta)
+{
+    struct mkd_edit *e = doc->edit;
+    MMIOT *f = doc->ctx;
+    STRING(Paragraph*) block;
+    STRING(int) at;
+    struct resync resync;
+    struct footnote_list *notes, *old = f->footnotes;
+    Paragraph *code, *p;
+    int i, j, k, n, from, to, stop, window;
+
+    CREATE(block);
+    for ( p = doc->code; p; p = p->next )
+	EXPAND(block) = p;
+    n = S(block);
+
+    /* start at the last block that begins (at the start of a line)
+     * before the change
+     */
+    for ( i = n-1; (i >= 0) && !between(T(block)[i]->lineno, 0, first); --i )
+	;
+
+    /* unless there's a code fence that was never closed before that;
+     * the change might close it, so start at the block it's in
+     */
+    for ( j = 0; j < i; j++ )
+	if ( T(block)[j]->para_flags & OPEN_FENCE ) {
+	    i = j;
+	    break;
+	}
+
+    /* and html and code blocks cut off the source in front of them,
+     * so if the change turns one into something else, that source
+     * might run into it
+     */
+    if ( (i >= 0) && (T(block)[i]->typ != SOURCE) )
+	--i;
+    while ( (i >= 0) && (T(block)[i]->lineno < 0) )
+	--i;
+
+    if ( i >= 0 )
+	from = T(block)[i]->lineno;
+    else {
+	i = 0;
+	from = e->header;
+    }
+
+    /* and any block that starts after the change is a place we
+     * might be able to stop
+     */
+    for ( k = i; (k < n) && (T(block)[k]->lineno <= last); ++k )
+	;
+    CREATE(at);
+    for ( j = k; j < n; j++ )
+	EXPAND(at) = (T(block)[j]->lineno < 0) ? -1 : T(block)[j]->lineno + delta;
+
+    /* try to recompile up to the next block after the change; if
+     * the recompile doesn't settle down by then (or saw an open code
+     * fence that might close later on), try again with twice as
+     * many blocks
+     */
+    for ( window = 1; ; window *= 2 ) {
+	while ( (k + window < n) && (T(at)[window] < 0) )
+	    ++window;
+	if ( k + window < n ) {
+	    to = T(at)[window];
+	    resync.count = window;
+	}
+	else {
+	    to = S(e->line);
+	    resync.count = n - k;
+	}
+	resync.at = T(at);
+	resync.unterminated = 0;
+
+	f->footnotes = calloc(1, sizeof f->footnotes[0]);
+	CREATE(f->footnotes->note);
+
+	code = ___mkd_compile_region(___mkd_edit_lines(doc, from, to), f, &resync);
+
+	notes = f->footnotes;
+	f->footnotes = old;
+
+	if ( (to < S(e->line)) && ((resync.stopped < 0) || resync.unterminated) ) {
+	    if ( code )
+		___mkd_freeParagraph(code);
+	    freenotes(notes);
+	    continue;
+	}
+	break;
+    }
+
+    stop = (resync.stopped < 0) ? n : k + resync.stopped;
+
+    refile(f->footnotes, notes, from,
+	   (stop < n) ? T(block)[stop]->lineno : INT_MAX, delta);
+    freenotes(notes);
+
+    /* splice the recompiled blocks in place of the old ones
+     */
+    if ( stop > i ) {
+	T(block)[stop-1]->next = 0;
+	___mkd_freeParagraph(T(block)[i]);
+    }
+    for ( j = stop; j < n; j++ )
+	if ( T(block)[j]->lineno >= 0 )
+	    T(block)[j]->lineno += delta;
+
+    if ( code ) {
+	for ( p = code; p->next; p = p->next )
+	    ;
+	p->next = (stop < n) ? T(block)[stop] : 0;
+    }
+    else
+	code = (stop < n) ? T(block)[stop] : 0;
+
+    if ( i > 0 )
+	T(block)[i-1]->next = code;
+    else
+	doc->code = code;
+
+    DELETE(block);
+    DELETE(at);
+
+    if ( is_flag_set(&(f->flags), MKD_TOC) && !is_flag_set(&(f->flags), MKD_STRICT) ) {
+	ParagraphRoot d = { 0, 0 };
+
+	T(d) = doc->code;
+	unlabel(doc->code);
+	___mkd_uniquify(&d, doc->code);
+    }
+    return 0;
+}
+
+
+/* replace `removed` bytes at `offset` in an editable document with
+ * `text`, then bring the compiled document (if there is one) up to
+ * date.
+ */
+int
+mkd_update(Document *doc, int offset, int removed, const char *text)
+{
+    struct mkd_edit *e;
+    struct acounts *charged;
+    mkd_flag_t flags;
+    double start;
+    int inserted = text ? strlen(text) : 0;
+    int first, last, bytes, delta, i, j, rc;
+
+    if ( !(doc && (e = doc->edit)) )
+	return EOF;
+    if ( (offset < 0) || (removed < 0) || (offset + removed > S(e->text)) )
+	return EOF;
+
+    first = whichline(e, offset);
+    last = whichline(e, offset+removed);
+    bytes = inserted - removed;
+
+    /* splice the change into the text
+     */
+    if ( bytes > 0 )
+	RESERVE(e->text, bytes);
+    memmove(T(e->text)+offset+inserted, T(e->text)+offset+removed,
+				    S(e->text)-(offset+removed));
+    if ( inserted )
+	memcpy(T(e->text)+offset, text, inserted);
+    S(e->text) += bytes;
+
+    /* and split the lines it touched again; the lines in between
+     * first and last are replaced by the lines in the new text, and
+     * the ones after that just move
+     */
+    for ( delta = -(last - first), i=0; i < inserted; i++ )
+	if ( text[i] == '\n' )
+	    ++delta;
+
+    if ( delta > 0 )
+	RESERVE(e->line, delta);
+    memmove(T(e->line)+last+1+delta, T(e->line)+last+1,
+				    (S(e->line)-(last+1)) * sizeof T(e->line)[0]);
+    S(e->line) += delta;
+    for ( i = last+1+delta; i < S(e->line); i++ )
+	T(e->line)[i] += bytes;
+    for ( j = first+1, i = 0; i < inserted; i++ )
+	if ( text[i] == '\n' )
+	    T(e->line)[j++] = offset+i+1;
+
+    if ( !doc->compiled )
+	return reread(doc);
+
+    /* a change at the top of the document might add or remove
+     * a pandoc header, so compile the whole thing again
+     */
+    if ( (first < e->header)
+	     || ( (first < 3) && !( is_flag_set(&e->flags, MKD_NOHEADER)
+				 || is_flag_set(&e->flags, MKD_STRICT) ) ) ) {
+	if ( reread(doc) == EOF )
+	    return EOF;
+	COPY_FLAGS(flags, doc->ctx->flags);
+	doc->dirty = 1;
+	return mkd_compile(doc, &flags) ? 0 : EOF;
+    }
+
+    charged = ACHARGE(doc, A_COMPILE);
+    start = STAT_START(doc);
+    rc = recompile(doc, first, last, delta);
+    STAT_TIME(doc, compile, start);
+    acharge(charged);
+
+    ___mkd_forget_html(doc);
+    return rc;
+}
+
+
+/*
+ * block diffs:  mkd_block_changes() generates the html for a document
+ * one block (each paragraph, list, header, table, and so forth at the
+ * top of the document) at a time and compares each block against the
+ * html it had the last time it was asked for.   Blocks keep their id
+ * for as long as their Paragraph is around, and when mkd_update()
+ * recompiles a stretch of a document the new blocks take over the ids
+ * of the old ones they replaced, so a live preview can patch only the
+ * blocks that changed.
+ */
+
+/* note where a block ends
+ */
+static int
+endblock(Paragraph *p, int end, void *ctx)
+{
+    struct blocklist *b = ctx;
+    struct mkd_block *blk = &EXPAND(b->now);
+
+    blk->size = end;
+    EXPAND(b->para) = p;
+    return 0;
+}
+
+
+static int
+different(struct mkd_block *new, struct mkd_block *old)
+{
+    return !old || (old->size != new->size)
+		|| (memcmp(old->html, new->html, new->size) != 0);
+}
+
+
+/* hand out ids to a run of new blocks [i,n) that took the place of
+ * the old blocks [j,k):  a new block with the same html as one of the
+ * old ones takes its id, and if that leaves as many new blocks as old
+ * ones the rest are the old blocks edited and take over their ids in
+ * order.   Anything else gets a new id.
+ */
+static void
+renumber(struct blocklist *b, int i, int n, int j, int k)
+{
+    struct mkd_block *blk, *old;
+    int x, y, new = 0, gone = 0;
+
+    for ( x=i; x < n; x++ ) {
+	blk = &T(b->now)[x];
+	for ( y=j; y < k; y++ ) {
+	    old = &T(b->last)[y];
+	    if ( !T(b->live)[old->id] && !different(blk, old) ) {
+		T(b->live)[old->id] = 1;
+		T(b->para)[x]->id = old->id;
+		blk->changed = 0;
+		break;
+	    }
+	}
+	if ( !T(b->para)[x]->id )
+	    ++new;
+    }
+    for ( y=j; y < k; y++ )
+	if ( !T(b->live)[T(b->last)[y].id] )
+	    ++gone;
+
+    for ( y=j, x=i; x < n; x++ ) {
+	blk = &T(b->now)[x];
+	if ( T(b->para)[x]->id )
+	    ;
+	else if ( new == gone ) {
+	    while ( T(b->live)[T(b->last)[y].id] )
+		y++;
+	    old = &T(b->last)[y++];
+	    T(b->para)[x]->id = old->id;
+	    blk->changed = different(blk, old);
+	}
+	else {
+	    T(b->para)[x]->id = b->nextid++;
+	    blk->changed = 1;
+	}
+	blk->id = T(b->para)[x]->id;
+    }
+}
+
+
+/* return all the blocks in a document, with the ones that have changed
+ * since the last call marked.   The blocks belong to the document.
+ */
+int
+mkd_block_changes(Document *doc, struct mkd_block **res)
+{
+    struct blocklist *b;
+    struct mkd_block *blk, *tail;
+    char *html;
+    int i, j, k, n, count, size, start;
+
+    if ( !(doc && res && doc->compiled) )
+	return EOF;
+
+    if ( (b = doc->blocks) == 0 ) {
+	if ( (b = doc->blocks = calloc(1, sizeof *b)) == 0 )
+	    return EOF;
+	b->nextid = 1;
+    }
+
+    S(b->now) = S(b->para) = 0;
+    if ( (size = ___mkd_document_blocks(doc, endblock, b)) == EOF )
+	return EOF;
+    html = T(doc->ctx->out);
+
+    /* what's left over at the end (trailing blank lines, footnotes)
+     * goes into block 0
+     */
+    tail = &EXPAND(b->now);
+    tail->size = size;
+
+    for ( start=i=0; i < S(b->now); i++ ) {
+	blk = &T(b->now)[i];
+	blk->html = html + start;
+	blk->size -= start;
+	start += blk->size;
+    }
+
+    /* hand out ids
+     */
+    S(b->live) = 0;
+    RESERVE(b->live, b->nextid);
+    memset(T(b->live), 0, b->nextid);
+    for ( i=0; i < S(b->para); i++ )
+	if ( T(b->para)[i]->id )
+	    T(b->live)[T(b->para)[i]->id] = 1;
+
+    /* blocks that are still around keep their ids, and runs of new
+     * blocks are matched against the old ones that went away between
+     * them (the last block last time was the leftovers, so don't look
+     * at that)
+     */
+    count = S(b->last) ? S(b->last)-1 : 0;
+    for ( j=i=0; i < S(b->para); ) {
+	blk = &T(b->now)[i];
+	if ( (blk->id = T(b->para)[i]->id) ) {
+	    for ( k=j; k < count && T(b->last)[k].id != blk->id; k++ )
+		;
+	    if ( k < count ) {
+		blk->changed = different(blk, &T(b->last)[k]);
+		j = k+1;
+	    }
+	    else
+		blk->changed = 1;
+	    i++;
+	}
+	else {
+	    for ( n=i; n < S(b->para) && !T(b->para)[n]->id; n++ )
+		;
+	    for ( k=j; k < count && !T(b->live)[T(b->last)[k].id]; k++ )
+		;
+	    renumber(b, i, n, j, k);
+	    i = n;
+	    j = k;
+	}
+    }
+
+    tail->id = 0;
+    tail->changed = different(tail, S(b->last) ? &T(b->last)[S(b->last)-1] : 0);
+
+    /* and remember it all for next time
+     */
+    S(b->html) = 0;
+    RESERVE(b->html, size);
+    memcpy(T(b->html), html, size);
+    S(b->html) = size;
+
+    S(b->last) = 0;
+    for ( i=0; i < S(b->now); i++ ) {
+	blk = &EXPAND(b->last);
+	*blk = T(b->now)[i];
+	blk->html = T(b->html) + (blk->html - html);
+    }
+
+    *res = T(b->now);
+    return S(b->now);
+}
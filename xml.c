@@ -35,6 +35,9 @@ mkd_xmlchar(unsigned char c)
 }
 
 
+static struct escapes xmlchars = { 0, 0xff, { '<', '>', '&', '"', '\'' } };
+
+
 /* write output in XML format
  */
 int
@@ -42,8 +45,18 @@ mkd_generatexml(char *p, int size, FILE *out)
 {
     unsigned char c;
     char *entity;
+    int clean;
 
-    while ( size-- > 0 ) {
+    while ( size > 0 ) {
+	if ( (clean = ___mkd_clean(p, size, &xmlchars)) > 0 ) {
+	    if ( fwrite(p, clean, 1, out) != 1 )
+		return EOF;
+	    p += clean;
+	    size -= clean;
+	    continue;
+	}
+
+	--size;
 	c = *p++;
 
 	if ( entity = mkd_xmlchar(c) )
@@ -62,12 +75,21 @@ mkd_xml(char *p, int size, char **res)
 {
     unsigned char c;
     char *entity;
+    int clean;
     Cstring f;
 
     CREATE(f);
     RESERVE(f, 100);
 
-    while ( size-- > 0 ) {
+    while ( size > 0 ) {
+	if ( (clean = ___mkd_clean(p, size, &xmlchars)) > 0 ) {
+	    Cswrite(&f, p, clean);
+	    p += clean;
+	    size -= clean;
+	    continue;
+	}
+
+	--size;
 	c = *p++;
 	if ( entity = mkd_xmlchar(c) )
 	    Cswrite(&f, entity, strlen(entity));